@@ -0,0 +1,178 @@
+#ifndef LSM_KV_ARENA_H
+#define LSM_KV_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+/*
+ * 简单的 bump allocator：按块向系统申请内存，块内顺序分配，不支持单独释放。
+ * memtable 的节点和 value 都放在这里，reset 时整体释放。
+ */
+class arena {
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    static const size_t CACHE_LINE = 64;
+
+    char *ptr     = nullptr; // 当前块中下一个可分配的位置
+    size_t remain = 0;       // 当前块剩余的字节数
+    size_t usage  = 0;       // 已向系统申请的总字节数
+    std::vector<char *> blocks;
+
+    char *allocateFallback(size_t bytes) {
+        if (bytes > BLOCK_SIZE / 4) { // 大对象单独成块，不浪费当前块的剩余空间
+            return allocateBlock(bytes);
+        }
+        ptr    = allocateBlock(BLOCK_SIZE);
+        remain = BLOCK_SIZE;
+        char *res = ptr;
+        ptr += bytes;
+        remain -= bytes;
+        return res;
+    }
+
+    char *allocateBlock(size_t bytes) {
+        // 块按 cache line 对齐，allocateAligned 才能据此判断节点是否跨行
+        bytes       = (bytes + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+        char *block = static_cast<char *>(std::aligned_alloc(CACHE_LINE, bytes));
+        blocks.push_back(block);
+        usage += bytes;
+        return block;
+    }
+
+public:
+    arena() {}
+
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    ~arena() {
+        for (char *block : blocks)
+            std::free(block);
+    }
+
+    char *allocate(size_t bytes) {
+        if (bytes <= remain) {
+            char *res = ptr;
+            ptr += bytes;
+            remain -= bytes;
+            return res;
+        }
+        return allocateFallback(bytes);
+    }
+
+    // 按指针大小对齐，用于存放节点；hot 不为 0 时还保证前 hot 个字节不跨 cache line
+    char *allocateAligned(size_t bytes, size_t hot = 0) {
+        const size_t align = alignof(void *);
+        size_t mod         = reinterpret_cast<uintptr_t>(ptr) & (align - 1);
+        size_t slop        = mod ? align - mod : 0;
+        size_t line        = (reinterpret_cast<uintptr_t>(ptr) + slop) & (CACHE_LINE - 1);
+        if (hot && line + hot > CACHE_LINE)
+            slop += CACHE_LINE - line; // 跳到下一个 cache line 的开头
+        if (bytes + slop <= remain) {
+            char *res = ptr + slop;
+            ptr += bytes + slop;
+            remain -= bytes + slop;
+            return res;
+        }
+        return allocateFallback(bytes); // 新块从 cache line 开头分配
+    }
+
+    // 整体释放，代价只与块数有关，和节点数无关
+    void reset() {
+        for (char *block : blocks)
+            std::free(block);
+        blocks.clear();
+        ptr    = nullptr;
+        remain = 0;
+        usage  = 0;
+    }
+
+    size_t memoryUsage() const {
+        return usage;
+    }
+};
+
+/*
+ * 供多线程同时分配的 arena：块内用 fetch_add 无锁地推进偏移，
+ * 只有当前块用完、需要换新块时才加锁。
+ */
+class concurrent_arena {
+private:
+    static const size_t BLOCK_SIZE = 256 * 1024;
+
+    struct block {
+        char *data;
+        size_t size;
+        std::atomic<size_t> used;
+    };
+
+    std::atomic<block *> cur{nullptr};
+    std::atomic<size_t> usage{0};
+    std::mutex lock; // 保护 blocks
+    std::vector<block *> blocks;
+
+    block *newBlock(size_t bytes) {
+        auto *b = new block;
+        b->data = static_cast<char *>(std::malloc(bytes));
+        b->size = bytes;
+        b->used.store(0, std::memory_order_relaxed);
+        blocks.push_back(b);
+        usage.fetch_add(bytes, std::memory_order_relaxed);
+        return b;
+    }
+
+public:
+    concurrent_arena() {}
+
+    concurrent_arena(const concurrent_arena &) = delete;
+    concurrent_arena &operator=(const concurrent_arena &) = delete;
+
+    ~concurrent_arena() {
+        reset();
+    }
+
+    // 返回的地址总是按指针大小对齐
+    char *allocateAligned(size_t bytes) {
+        const size_t align = alignof(void *);
+        bytes              = (bytes + align - 1) & ~(align - 1);
+        if (bytes > BLOCK_SIZE / 4) { // 大对象单独成块
+            std::lock_guard<std::mutex> guard(lock);
+            block *b = newBlock(bytes);
+            b->used.store(bytes, std::memory_order_relaxed);
+            return b->data;
+        }
+        while (true) {
+            block *b = cur.load(std::memory_order_acquire);
+            if (b) {
+                size_t off = b->used.fetch_add(bytes, std::memory_order_relaxed);
+                if (off + bytes <= b->size)
+                    return b->data + off;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            if (cur.load(std::memory_order_relaxed) == b) // 没有其它线程抢先换块
+                cur.store(newBlock(BLOCK_SIZE), std::memory_order_release);
+        }
+    }
+
+    // 调用方需保证此时没有并发的分配和读取
+    void reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        for (block *b : blocks) {
+            std::free(b->data);
+            delete b;
+        }
+        blocks.clear();
+        cur.store(nullptr, std::memory_order_relaxed);
+        usage.store(0, std::memory_order_relaxed);
+    }
+
+    size_t memoryUsage() const {
+        return usage.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // LSM_KV_ARENA_H
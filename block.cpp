@@ -0,0 +1,289 @@
+#include "block.h"
+
+#include "coding.h"
+#include "lz.h"
+
+#include <algorithm>
+#include <cstring>
+
+void blockbuilder::add(uint64_t key, const char *val, uint32_t len) {
+    uint64_t delta = key - lastKey;
+    if (counter == 0) {
+        restarts.push_back(buf.size());
+        delta = key; // restart 点上存完整的 key
+    }
+    if (++counter == RESTART_INTERVAL)
+        counter = 0;
+    putVarint64(buf, delta);
+    putVarint32(buf, len);
+    buf.append(val, len);
+    lastKey = key;
+}
+
+const std::string &blockbuilder::finish() {
+    for (uint32_t r : restarts)
+        buf.append(reinterpret_cast<const char *>(&r), 4);
+    uint32_t n = restarts.size() | BLOCK_DELTA;
+    buf.append(reinterpret_cast<const char *>(&n), 4);
+    return buf;
+}
+
+void blockbuilder::reset() {
+    buf.clear();
+    restarts.clear();
+    counter = 0;
+    lastKey = 0;
+}
+
+void compressBlock(const std::string &block, COMPRESSION_TYPE compression, std::string &dst) {
+    static thread_local std::string packed;
+    lz::compress(block.data(), block.size(), packed, compression == COMPRESSION_HIGH ? lz::HIGH : lz::FAST);
+    if (packed.size() < block.size() - block.size() / 8) {
+        dst.append(packed);
+        dst.push_back(BLOCK_LZ);
+    } else {
+        dst.append(block);
+        dst.push_back(BLOCK_RAW);
+    }
+}
+
+bool uncompressBlock(std::string &block) {
+    if (block.empty())
+        return false;
+    char type = block.back();
+    block.pop_back();
+    if (type == BLOCK_RAW)
+        return true;
+    static thread_local std::string res;
+    if (type != BLOCK_LZ || !lz::uncompress(block.data(), block.size(), res))
+        return false;
+    block.swap(res);
+    return true;
+}
+
+blockiter::blockiter(std::shared_ptr<const std::string> block) :
+    blockiter(block, block ? block->data() : nullptr, block ? block->size() : 0) {}
+
+blockiter::blockiter(std::shared_ptr<const void> owner, const char *block, size_t size) : owner(std::move(owner)) {
+    if (size < 4) {
+        corrupt = true;
+        return;
+    }
+    std::memcpy(&restartCount, block + size - 4, 4);
+    delta = restartCount & BLOCK_DELTA;
+    restartCount &= ~BLOCK_DELTA;
+    if (restartCount == 0 || (size - 4) / 4 < restartCount) {
+        restartCount = 0;
+        corrupt      = true;
+        return;
+    }
+    data  = block;
+    limit = size - 4 - 4 * restartCount;
+    cur   = limit;
+}
+
+uint32_t blockiter::restartPoint(uint32_t i) const {
+    uint32_t res;
+    std::memcpy(&res, data + limit + 4 * i, 4);
+    return res;
+}
+
+bool blockiter::keyAt(uint32_t offset, uint64_t &key) const {
+    if (!delta) {
+        if (offset + 8 > limit)
+            return false;
+        std::memcpy(&key, data + offset, 8);
+        return true;
+    }
+    return offset < limit && getVarint64(data + offset, data + limit, &key);
+}
+
+void blockiter::parse(uint64_t prevKey) {
+    if (cur >= limit) {
+        corrupt = corrupt || cur > limit; // restart 点指到了条目区域之外
+        cur     = limit;
+        return;
+    }
+    if (!delta) {
+        if (cur + 12 > limit) {
+            cur     = limit;
+            corrupt = true;
+            return;
+        }
+        std::memcpy(&curKey, data + cur, 8);
+        std::memcpy(&valLen, data + cur + 8, 4);
+        valOff = cur + 12;
+    } else {
+        const char *end = data + limit;
+        uint64_t diff;
+        const char *p = getVarint64(data + cur, end, &diff);
+        if (p)
+            p = getVarint32(p, end, &valLen);
+        if (!p) {
+            cur     = limit;
+            corrupt = true;
+            return;
+        }
+        curKey = prevKey + diff;
+        valOff = p - data;
+    }
+    if (valLen > limit - valOff) { // 条目越过了块尾
+        cur     = limit;
+        corrupt = true;
+    }
+}
+
+void blockiter::seekToFirst() {
+    cur         = restartCount ? restartPoint(0) : limit;
+    nextRestart = 1;
+    parse(0);
+}
+
+void blockiter::seek(uint64_t key) {
+    if (!restartCount)
+        return;
+    // 找最后一个 key < 目标的 restart 点
+    uint32_t l = 0, r = restartCount - 1;
+    while (l < r) {
+        uint32_t mid = (l + r + 1) / 2;
+        uint64_t k;
+        if (keyAt(restartPoint(mid), k) && k < key)
+            l = mid;
+        else
+            r = mid - 1;
+    }
+    cur         = restartPoint(l);
+    nextRestart = l + 1;
+    parse(0);
+    while (valid() && curKey < key)
+        next();
+}
+
+void blockiter::next() {
+    cur = valOff + valLen;
+    if (nextRestart < restartCount && cur == restartPoint(nextRestart)) { // restart 点上是完整的 key
+        nextRestart++;
+        parse(0);
+    } else {
+        parse(curKey);
+    }
+}
+
+bool blockindex::add(const BlockIndex &b) {
+    if (count && b.offset != nextOffset)
+        return false;
+    if (count % INDEX_INTERVAL == 0) {
+        restarts.push_back(buf.size());
+        firstKeys.push_back(b.lastKey);
+        putVarint64(buf, b.lastKey);
+        putVarint32(buf, b.offset);
+    } else {
+        putVarint64(buf, b.lastKey - lastKey);
+    }
+    putVarint32(buf, b.size);
+    if (checksums)
+        buf.append(reinterpret_cast<const char *>(&b.crc), 4);
+    count++;
+    lastKey    = b.lastKey;
+    nextOffset = b.offset + b.size;
+    return true;
+}
+
+const char *blockindex::decode(const char *p, bool first, BlockIndex &b) const {
+    const char *end = buf.data() + buf.size();
+    uint64_t key;
+    uint32_t offset = b.offset + b.size;
+    p               = getVarint64(p, end, &key);
+    if (p && first)
+        p = getVarint32(p, end, &offset);
+    if (p)
+        p = getVarint32(p, end, &b.size);
+    if (p && checksums) {
+        if (end - p < 4)
+            return nullptr;
+        std::memcpy(&b.crc, p, 4);
+        p += 4;
+    }
+    if (!p)
+        return nullptr;
+    b.lastKey = first ? key : b.lastKey + key;
+    b.offset  = offset;
+    return p;
+}
+
+BlockIndex blockindex::get(int p) const {
+    BlockIndex b{0, 0, 0};
+    const char *cur = buf.data() + restarts[p / INDEX_INTERVAL];
+    for (int i = 0; i <= p % (int)INDEX_INTERVAL; ++i)
+        cur = decode(cur, i == 0, b); // 编码在 add 或 decodeFrom 时已经检查过
+    return b;
+}
+
+int blockindex::seek(uint64_t key) const {
+    if (!count)
+        return 0;
+    // 找最后一个第一项的 key < 目标的组，目标只可能在这一组或下一组的第一项
+    int l = std::lower_bound(firstKeys.begin(), firstKeys.end(), key) - firstKeys.begin();
+    if (l > 0)
+        l--;
+    BlockIndex b{0, 0, 0};
+    const char *cur = buf.data() + restarts[l];
+    int p           = l * INDEX_INTERVAL;
+    for (; p < (int)count; ++p) {
+        cur = decode(cur, p % INDEX_INTERVAL == 0, b);
+        if (b.lastKey >= key)
+            break;
+    }
+    return p;
+}
+
+void blockindex::clear() {
+    buf.clear();
+    restarts.clear();
+    firstKeys.clear();
+    count      = 0;
+    lastKey    = 0;
+    nextOffset = 0;
+    checksums  = false; // 复用时下一个表可能是没有校验和的旧格式
+}
+
+void blockindex::encodeTo(std::string &dst) const {
+    dst.append(buf);
+    for (uint32_t r : restarts)
+        dst.append(reinterpret_cast<const char *>(&r), 4);
+    uint32_t n = restarts.size();
+    dst.append(reinterpret_cast<const char *>(&n), 4);
+}
+
+bool blockindex::decodeFrom(const char *p, size_t len, uint32_t count, bool checksums) {
+    clear();
+    this->checksums = checksums;
+    uint32_t groups = (count + INDEX_INTERVAL - 1) / INDEX_INTERVAL, n;
+    if (len < 4)
+        return false;
+    std::memcpy(&n, p + len - 4, 4);
+    if (n != groups || (len - 4) / 4 < n)
+        return false;
+    buf.assign(p, len - 4 - 4 * n);
+    restarts.resize(n);
+    std::memcpy(restarts.data(), p + buf.size(), 4 * n);
+    // 完整解码一遍，之后 get 和 seek 不再检查
+    BlockIndex b{0, 0, 0};
+    const char *cur = buf.data();
+    for (uint32_t i = 0; i < count; ++i) {
+        bool first = i % INDEX_INTERVAL == 0;
+        if (first && restarts[i / INDEX_INTERVAL] != (uint32_t)(cur - buf.data()))
+            return false;
+        uint32_t end = b.offset + b.size;
+        if (!(cur = decode(cur, first, b)) || (i && (b.offset != end || b.lastKey < lastKey)))
+            return false;
+        if (first)
+            firstKeys.push_back(b.lastKey);
+        lastKey = b.lastKey;
+    }
+    if (cur != buf.data() + buf.size())
+        return false;
+    this->count = count;
+    nextOffset  = b.offset + b.size;
+    return true;
+}
@@ -0,0 +1,188 @@
+#ifndef LSM_KV_BLOCK_H
+#define LSM_KV_BLOCK_H
+
+#include "valueref.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * sstable 的数据块。
+ *
+ * 格式：
+ *   [条目]...[u32 restart 偏移]...[u32 restart 个数 | BLOCK_DELTA]
+ *   条目 = [varint key 与上一条目 key 的差][varint value 长度][value]，restart 点上的条目存完整的 key
+ * 每 RESTART_INTERVAL 个条目记一个 restart 点（条目在块内的偏移），
+ * 查找时先在 restart 点上二分，再从 restart 点顺序往后找。
+ * 没有 BLOCK_DELTA 标记的是旧格式，条目 = [u64 key][u32 value 长度][value]，仍然可以读取。
+ */
+
+const uint32_t BLOCK_SIZE       = 4096; // 块写到这么大就结束，实际会略大一些
+const uint32_t RESTART_INTERVAL = 16;
+const uint32_t BLOCK_DELTA      = 1u << 31; // restart 个数的最高位，条目用 varint 编码
+
+class blockbuilder {
+private:
+    std::string buf;
+    std::vector<uint32_t> restarts;
+    uint32_t counter = 0; // 距离上一个 restart 点的条目数
+    uint64_t lastKey = 0;
+
+public:
+    blockbuilder() {}
+
+    void add(uint64_t key, const char *val, uint32_t len); // key 必须递增
+
+    size_t estimatedSize() const {
+        return buf.size() + 4 * restarts.size() + 4;
+    }
+
+    bool empty() const {
+        return buf.empty();
+    }
+
+    uint64_t getLastKey() const {
+        return lastKey;
+    }
+
+    const std::string &finish(); // 追加 restart 数组，返回整个块
+    void reset();
+};
+
+/*
+ * 块压缩：footer 带 TABLE_COMPRESSED 的 sstable 中，每个块在文件中是 [内容][u8 类型]，
+ * 类型为 BLOCK_LZ 时内容是用 lz 压缩过的块（见 lz.h），为 BLOCK_RAW 时是原样的块。
+ * 块索引中的大小和 crc32c 都按文件中的样子算，包括类型字节。
+ */
+enum COMPRESSION_TYPE {
+    COMPRESSION_NONE,
+    COMPRESSION_FAST, // lz::FAST
+    COMPRESSION_HIGH  // lz::HIGH，压缩率更高、写得更慢，解压一样快
+};
+
+const char BLOCK_RAW = 0;
+const char BLOCK_LZ  = 1;
+
+// 压缩 block，连同类型字节追加到 dst；压缩后小不了 1/8 时原样存放
+void compressBlock(const std::string &block, COMPRESSION_TYPE compression, std::string &dst);
+// 从文件中读到的块（包括类型字节）就地还原成 blockiter 能解析的内容，格式不对时返回 false
+bool uncompressBlock(std::string &block);
+
+class blockiter {
+private:
+    std::shared_ptr<const void> owner; // 迭代期间持有整个块所在的内存
+    const char *data      = nullptr;
+    uint32_t limit        = 0; // restart 数组的起始位置，条目都在它之前
+    uint32_t restartCount = 0;
+    uint32_t cur          = 0; // 当前条目的偏移，等于 limit 时无效
+    uint32_t valOff       = 0; // 当前 value 的偏移
+    uint32_t nextRestart  = 0; // cur 之后的第一个 restart 点的序号
+    uint64_t curKey       = 0;
+    uint32_t valLen       = 0;
+    bool delta            = false; // 条目是否用 varint 编码
+    bool corrupt          = false;
+
+    uint32_t restartPoint(uint32_t i) const;
+    bool keyAt(uint32_t offset, uint64_t &key) const; // restart 点上条目的 key
+    void parse(uint64_t prevKey); // 解析 cur 处的条目，prevKey 为上一条目的 key，restart 点上为 0
+
+public:
+    blockiter() {}
+
+    // 块格式不对时迭代器一直无效，并且 corrupted() 为真；block 为空指针表示块没能读出来，同样处理
+    explicit blockiter(std::shared_ptr<const std::string> block);
+    blockiter(std::shared_ptr<const void> owner, const char *block, size_t size); // 块在 owner 持有的内存中，如 mmap
+
+    bool valid() const {
+        return cur < limit;
+    }
+
+    bool corrupted() const { // 块本身或迭代中遇到的条目格式不对，此后一直无效
+        return corrupt;
+    }
+
+    void seekToFirst();
+    void seek(uint64_t key); // 定位到第一个 >= key 的条目
+    void next();
+
+    uint64_t key() const {
+        return curKey;
+    }
+
+    const char *valueData() const {
+        return data + valOff;
+    }
+
+    uint32_t valueLen() const {
+        return valLen;
+    }
+
+    std::string value() const {
+        return std::string(valueData(), valLen);
+    }
+
+    valueref valueRef() const { // 不拷贝，引用持有整个块
+        return valueref(owner, valueData(), valLen);
+    }
+};
+
+/*
+ * 块索引：sstable 的每个块一项，块按顺序首尾相接，内存中和文件中是同一份编码。
+ *   每 INDEX_INTERVAL 项为一组，组内第一项 [varint 最大 key][varint 偏移][varint 大小]，
+ *   其余项 [varint 最大 key 与上一项的差][varint 大小]，偏移接着上一块算；
+ *   带校验和时每项最后还有 [u32 块的 crc32c]；
+ *   编码之后是每组第一项的位置 [u32]...，最后是 [u32 组数]。
+ * 一项通常只要几个字节，定长的旧格式每项 16 字节。
+ * 按块号取一项时从所在组的开头往后解码，按 key 找块时先在各组的第一项上二分。
+ */
+const uint32_t INDEX_INTERVAL = 16;
+
+struct BlockIndex {
+    uint64_t lastKey; // 块内最大的 key
+    uint32_t offset;
+    uint32_t size;
+    uint32_t crc = 0; // 块的 crc32c，没有校验和时为 0
+};
+
+class blockindex {
+private:
+    std::string buf;
+    std::vector<uint32_t> restarts; // 每组第一项在 buf 中的位置
+    std::vector<uint64_t> firstKeys; // 每组第一项的 key，只在内存中，二分时不用解码
+    uint32_t count      = 0;
+    uint64_t lastKey    = 0;
+    uint32_t nextOffset = 0; // 下一块的偏移
+    bool checksums      = false;
+
+    // 从 p 处解码一项，b 传入上一项（组内第一项不用），返回时为这一项；编码不合法时返回 nullptr
+    const char *decode(const char *p, bool first, BlockIndex &b) const;
+
+public:
+    explicit blockindex(bool checksums = false) : checksums(checksums) {}
+
+    bool add(const BlockIndex &b); // 与上一块不首尾相接时返回 false
+
+    bool hasChecksums() const {
+        return checksums;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    BlockIndex get(int p) const;
+    int seek(uint64_t key) const; // 第一个最大 key >= key 的块，没有返回块数
+    void clear();
+
+    size_t encodedSize() const {
+        return buf.size() + 4 * restarts.size() + 4;
+    }
+
+    void encodeTo(std::string &dst) const;
+    bool decodeFrom(const char *p, size_t len, uint32_t count, bool checksums); // 编码不合法时返回 false
+};
+
+#endif // LSM_KV_BLOCK_H
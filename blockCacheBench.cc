@@ -0,0 +1,86 @@
+#include "kvstore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * block cache 大小测试：
+ * 先写入 n 个 key（value 100 字节）并落盘，然后对不同的 Options::blockCacheSize
+ * 重新打开同一份数据，按 Zipf 分布（参数 0.99）做随机 get，统计吞吐和缓存命中率。
+ * 热点 key 打散到整个 key 空间，避免都落在同几个块里。
+ */
+
+class zipfian {
+private:
+    std::vector<double> cdf;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> uniform;
+
+public:
+    zipfian(uint64_t n, double theta, uint64_t seed) : cdf(n), rng(seed), uniform(0, 1) {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; ++i)
+            cdf[i] = sum += 1 / std::pow(i + 1, theta);
+        for (double &c : cdf)
+            c /= sum;
+    }
+
+    uint64_t next() { // 返回排名，0 最热
+        return std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+    }
+};
+
+int main(int argc, char *argv[]) {
+    uint64_t n   = 200000;
+    uint64_t ops = 200000;
+    if (argc >= 2)
+        n = std::stoull(argv[1]);
+    if (argc >= 3)
+        ops = std::stoull(argv[2]);
+
+    std::cout << "Usage: " << argv[0] << " [number of keys] [number of gets]" << std::endl;
+    std::cout << "keys: " << n << ", gets: " << ops << std::endl << std::endl;
+
+    {
+        KVStore store("./data");
+        store.reset();
+        for (uint64_t i = 0; i < n; ++i)
+            store.put(i, std::string(100, 'a' + i % 26));
+    } // 析构时把 memtable 也写成 sstable，之后的 get 都要读文件
+
+    std::cout << std::left << std::setw(14) << "cache (MB)" << std::setw(14) << "ops/s" << std::setw(14)
+              << "hit rate (%)" << std::setw(14) << "usage (MB)" << std::endl;
+
+    for (size_t cacheMB : {0, 1, 4, 16, 64}) {
+        Options options;
+        options.blockCacheSize = cacheMB * 1024 * 1024;
+        KVStore store("./data", options);
+        zipfian zipf(n, 0.99, 1);
+
+        uint64_t lost = 0;
+        auto start    = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < ops; ++i) {
+            uint64_t key = zipf.next() * 2654435761ULL % n;
+            lost += store.get(key) != std::string(100, 'a' + key % 26);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        if (lost)
+            std::cerr << "Error: lost " << lost << " keys" << std::endl;
+
+        KVStore::Stats stats = store.getStats();
+        uint64_t lookups     = stats.cacheHits + stats.cacheMisses;
+        std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(14) << cacheMB << std::setw(14)
+                  << ops / std::chrono::duration<double>(end - start).count() << std::setw(14)
+                  << (lookups ? 100.0 * stats.cacheHits / lookups : 0) << std::setw(14)
+                  << stats.cacheUsage / 1024.0 / 1024.0 << std::endl;
+    }
+    KVStore("./data").reset();
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "blockcache.h"
+
+#include <functional>
+
+std::string blockcache::makeKey(const std::string &file, uint64_t offset) {
+    std::string key = file;
+    key.append(reinterpret_cast<const char *>(&offset), 8);
+    return key;
+}
+
+size_t blockcache::charge(const entry &e) {
+    return e.block->size() + e.file.size() + sizeof(entry) + 64; // 64 为链表和哈希表节点的大致开销
+}
+
+std::shared_ptr<const std::string> blockcache::lookup(const std::string &file, uint64_t offset) {
+    std::string key = makeKey(file, offset);
+    shard &s        = shards[std::hash<std::string>()(key) % SHARDS];
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.table.find(key);
+    if (it == s.table.end()) {
+        s.misses++;
+        return nullptr;
+    }
+    s.hits++;
+    s.lru.splice(s.lru.begin(), s.lru, it->second); // 移到最前
+    return it->second->block;
+}
+
+void blockcache::insert(const std::string &file, uint64_t offset, std::shared_ptr<const std::string> block) {
+    if (!capacity)
+        return;
+    std::string key = makeKey(file, offset);
+    shard &s        = shards[std::hash<std::string>()(key) % SHARDS];
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.table.find(key);
+    if (it != s.table.end()) { // 其他读者先放进来了
+        s.usage -= charge(*it->second);
+        s.lru.erase(it->second);
+        s.table.erase(it);
+    }
+    s.lru.push_front({file, offset, std::move(block)});
+    s.table[key] = s.lru.begin();
+    s.usage += charge(s.lru.front());
+    while (s.usage > capacity / SHARDS && !s.lru.empty()) {
+        entry &last = s.lru.back();
+        s.usage -= charge(last);
+        s.table.erase(makeKey(last.file, last.offset));
+        s.lru.pop_back();
+    }
+}
+
+void blockcache::evict(const std::string &file) {
+    for (shard &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        for (auto it = s.lru.begin(); it != s.lru.end();) {
+            if (it->file != file) {
+                ++it;
+                continue;
+            }
+            s.usage -= charge(*it);
+            s.table.erase(makeKey(it->file, it->offset));
+            it = s.lru.erase(it);
+        }
+    }
+}
+
+void blockcache::clear() {
+    for (shard &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.lru.clear();
+        s.table.clear();
+        s.usage = 0;
+    }
+}
+
+size_t blockcache::usage() {
+    size_t res = 0;
+    for (shard &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        res += s.usage;
+    }
+    return res;
+}
+
+uint64_t blockcache::hits() {
+    uint64_t res = 0;
+    for (shard &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        res += s.hits;
+    }
+    return res;
+}
+
+uint64_t blockcache::misses() {
+    uint64_t res = 0;
+    for (shard &s : shards) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        res += s.misses;
+    }
+    return res;
+}
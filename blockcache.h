@@ -0,0 +1,64 @@
+#ifndef LSM_KV_BLOCKCACHE_H
+#define LSM_KV_BLOCKCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+ * sstable 数据块的缓存，按 (文件名, 块偏移) 查找，总大小不超过 capacity 字节。
+ * 分成 SHARDS 个分片，每个分片一把锁、各自按 LRU 淘汰，多个读者很少争同一把锁。
+ * 返回 shared_ptr，被淘汰的块要等正在使用它的读者用完才释放。
+ * 线程安全。
+ */
+class blockcache {
+private:
+    static const int SHARDS = 16;
+
+    struct entry {
+        std::string file;
+        uint64_t offset;
+        std::shared_ptr<const std::string> block;
+    };
+
+    struct shard {
+        std::mutex lock;
+        std::list<entry> lru; // 越靠前越新
+        std::unordered_map<std::string, std::list<entry>::iterator> table;
+        size_t usage    = 0;
+        uint64_t hits   = 0;
+        uint64_t misses = 0;
+    };
+
+    size_t capacity;
+    shard shards[SHARDS];
+
+    static std::string makeKey(const std::string &file, uint64_t offset);
+    static size_t charge(const entry &e); // 一个块占用的内存
+
+public:
+    explicit blockcache(size_t capacity) : capacity(capacity) {}
+
+    blockcache(const blockcache &) = delete;
+    blockcache &operator=(const blockcache &) = delete;
+
+    // 不在缓存中时返回 nullptr
+    std::shared_ptr<const std::string> lookup(const std::string &file, uint64_t offset);
+    void insert(const std::string &file, uint64_t offset, std::shared_ptr<const std::string> block);
+    void evict(const std::string &file); // 删除文件之前调用，去掉它的所有块
+    void clear();
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    size_t usage();
+    uint64_t hits();
+    uint64_t misses();
+};
+
+#endif // LSM_KV_BLOCKCACHE_H
@@ -1,18 +1,29 @@
 #include "bloom.h"
 
+// MurmurHash3_x64_128 按 uint64_t 写出结果，再按 uint32_t 读会违反 strict aliasing，
+// 这里按小端的顺序拆成 4 个 32 位的值，与文件中已有的 bloom 一致
+static void hash4(uint64_t key, uint32_t hashV[4]) {
+    uint64_t h[2];
+    MurmurHash3_x64_128(&key, sizeof(key), 1, h);
+    hashV[0] = h[0];
+    hashV[1] = h[0] >> 32;
+    hashV[2] = h[1];
+    hashV[3] = h[1] >> 32;
+}
+
 void bloom::insert(uint64_t key) {
-    MurmurHash3_x64_128(&key, sizeof(key), 1, hashV);
+    uint32_t hashV[4];
+    hash4(key, hashV);
     for (int i = 0; i < 4; ++i) {
-        uint32_t p = (hashV[i] % (8 * M));
-        s[p]       = true;
+        setBit(hashV[i] % (8 * M));
     }
 }
 
-bool bloom::search(uint64_t key) {
-    MurmurHash3_x64_128(&key, sizeof(key), 1, hashV);
+bool bloom::search(uint64_t key) const {
+    uint32_t hashV[4];
+    hash4(key, hashV);
     for (int i = 0; i < 4; ++i) {
-        uint32_t p = (hashV[i] % (8 * M));
-        if (!s[p])
+        if (!getBit(hashV[i] % (8 * M)))
             return false;
     }
     return true;
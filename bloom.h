@@ -2,45 +2,42 @@
 #define LSM_KV_BLOOM_H
 #include "MurmurHash3.h"
 
-#include <bitset>
 #include <cstdint>
+#include <cstring>
 
 const uint32_t M = 10240;
 
 class bloom {
 private:
-    std::bitset<8 * M> s;
-    uint32_t hashV[4];
+    unsigned char s[M]; // 与文件中的格式相同：第 p 位在第 p / 8 字节的第 p % 8 位，可以整块读写
 
 public:
-    bloom() {}
-
-    ~bloom() {
-        s.reset();
+    bloom() {
+        reset();
     }
 
     void reset() {
-        s.reset();
+        std::memset(s, 0, M);
     }
 
-    void setBitset(std::bitset<8 * M> t) {
-        s = t;
+    bool getBit(uint32_t p) const {
+        return (s[p >> 3] >> (p & 7)) & 1;
     }
 
-    std::bitset<8 * M> getBitset() {
-        return s;
+    void setBit(uint32_t p) {
+        s[p >> 3] |= 1 << (p & 7);
     }
 
-    bool getBit(uint32_t p) {
-        return s[p];
+    const char *data() const { // M 字节
+        return reinterpret_cast<const char *>(s);
     }
 
-    void setBit(uint32_t p) {
-        s[p] = true;
+    char *data() {
+        return reinterpret_cast<char *>(s);
     }
 
     void insert(uint64_t key);
-    bool search(uint64_t key);
+    bool search(uint64_t key) const; // 不修改成员，多个读者可以同时查
 };
 
 #endif // LSM_KV_BLOOM_H
@@ -0,0 +1,54 @@
+#ifndef LSM_KV_CODING_H
+#define LSM_KV_CODING_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * 变长整数（varint）：每字节低 7 位存数据，最高位为 1 表示后面还有字节。
+ * 小的数占的字节少，用来存 key 的差值、长度和偏移。
+ */
+
+inline void putVarint64(std::string &dst, uint64_t v) {
+    char buf[10];
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (char)v;
+    dst.append(buf, n);
+}
+
+inline void putVarint32(std::string &dst, uint32_t v) {
+    putVarint64(dst, v);
+}
+
+// 从 [p, limit) 解码一个 varint，返回下一字节的位置；越界或过长时返回 nullptr
+inline const char *getVarint64(const char *p, const char *limit, uint64_t *v) {
+    if (p < limit && !(*p & 0x80)) { // 只有一个字节，最常见
+        *v = (unsigned char)*p;
+        return p + 1;
+    }
+    uint64_t res = 0;
+    for (int shift = 0; shift <= 63 && p < limit; shift += 7) {
+        uint64_t byte = (unsigned char)*p++;
+        res |= (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = res;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+inline const char *getVarint32(const char *p, const char *limit, uint32_t *v) {
+    uint64_t res;
+    p = getVarint64(p, limit, &res);
+    if (!p || res > UINT32_MAX)
+        return nullptr;
+    *v = (uint32_t)res;
+    return p;
+}
+
+#endif // LSM_KV_CODING_H
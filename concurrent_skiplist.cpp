@@ -0,0 +1,192 @@
+#include "concurrent_skiplist.h"
+
+#include <cstring>
+#include <functional>
+#include <thread>
+
+csnode *concurrent_skiplist::newNode(uint64_t key, int level) {
+    size_t size = sizeof(csnode) + sizeof(std::atomic<csnode *>) * (level - 1);
+    auto *node  = reinterpret_cast<csnode *>(mem.allocateAligned(size));
+    node->key   = key;
+    node->level = level;
+    node->val.store(nullptr, std::memory_order_relaxed);
+    for (int i = 0; i < level; ++i)
+        node->nxt[i].store(nullptr, std::memory_order_relaxed);
+    return node;
+}
+
+csvalue *concurrent_skiplist::newValue(const std::string &str, uint64_t seq) {
+    auto *v = reinterpret_cast<csvalue *>(mem.allocateAligned(sizeof(csvalue) + str.size()));
+    v->seq  = seq;
+    v->len  = str.size();
+    std::memcpy(v->data, str.data(), str.size());
+    return v;
+}
+
+void concurrent_skiplist::init() {
+    head = newNode(0, MAX_LEVEL);
+    curMaxL.store(1, std::memory_order_relaxed);
+    bytes.store(0, std::memory_order_relaxed);
+}
+
+int concurrent_skiplist::randLevel() {
+    // 每个线程一个随机数发生器，避免 rand() 的全局状态
+    thread_local fastrand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return rng.level(1, MAX_LEVEL);
+}
+
+void concurrent_skiplist::findSplice(uint64_t key, int level, csnode *before, csnode *&prev, csnode *&next) {
+    while (true) {
+        csnode *x = before->nxt[level].load(std::memory_order_acquire);
+        if (!x || x->key >= key) {
+            prev = before;
+            next = x;
+            return;
+        }
+        before = x;
+    }
+}
+
+void concurrent_skiplist::insert(uint64_t key, const std::string &str) {
+    upsertOrdered(key, str, 0);
+}
+
+int64_t concurrent_skiplist::upsert(uint64_t key, const std::string &str) {
+    return upsertOrdered(key, str, 0);
+}
+
+int64_t concurrent_skiplist::upsertOrdered(uint64_t key, const std::string &str, uint64_t seq) {
+    csnode *prev[MAX_LEVEL];
+    csnode *next[MAX_LEVEL];
+
+    int maxL = curMaxL.load(std::memory_order_relaxed);
+    for (int i = MAX_LEVEL - 1; i >= maxL; --i) { // 尚未使用的层，前驱都是 head
+        prev[i] = head;
+        next[i] = nullptr;
+    }
+    csnode *x = head;
+    for (int i = maxL - 1; i >= 0; --i) {
+        findSplice(key, i, x, prev[i], next[i]);
+        x = prev[i];
+    }
+
+    csvalue *val = newValue(str, seq);
+    if (next[0] && next[0]->key == key) // 已存在，直接替换 value
+        return replaceValue(next[0], val);
+
+    int newLevel = randLevel();
+    while (newLevel > maxL && !curMaxL.compare_exchange_weak(maxL, newLevel, std::memory_order_relaxed)) {
+    }
+    // 层数在 find 之后可能被其它线程提高，这些层的 splice 仍是 head，CAS 失败时会重新查找
+
+    csnode *node = newNode(key, newLevel);
+    node->val.store(val, std::memory_order_relaxed);
+    for (int i = 0; i < newLevel; ++i) {
+        while (true) {
+            node->nxt[i].store(next[i], std::memory_order_relaxed);
+            if (prev[i]->nxt[i].compare_exchange_strong(next[i], node, std::memory_order_release))
+                break;
+            // 有其它线程在这一层插入了节点，从原前驱重新查找
+            findSplice(key, i, prev[i], prev[i], next[i]);
+            if (i == 0 && next[0] && next[0]->key == key) {
+                // 同一个 key 被并发插入，本节点尚未可见，改为更新对方的 value
+                return replaceValue(next[0], val);
+            }
+        }
+    }
+
+    bytes.fetch_add(12 + str.size(), std::memory_order_relaxed);
+    return 12 + str.size();
+}
+
+int64_t concurrent_skiplist::replaceValue(csnode *node, csvalue *val) {
+    csvalue *old = node->val.load(std::memory_order_acquire);
+    do {
+        if (val->seq && old->seq > val->seq)
+            return 0; // 日志中更靠后的写入已经先插进来了，这次的 value 作废，留在 arena 中
+    } while (!node->val.compare_exchange_weak(old, val, std::memory_order_acq_rel, std::memory_order_acquire));
+    bytes.fetch_add(val->len - old->len, std::memory_order_relaxed); // 无符号回绕，结果仍然正确
+    return (int64_t)val->len - old->len;
+}
+
+bool concurrent_skiplist::find(uint64_t key, const char *&val, uint32_t &len) {
+    csnode *x = lowerBound(key);
+    if (!x || x->key != key)
+        return false;
+    csvalue *v = x->val.load(std::memory_order_acquire);
+    val        = v->data;
+    len        = v->len;
+    return true;
+}
+
+void concurrent_skiplist::scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) {
+    csnode *x = lowerBound(key1);
+    while (x && x->key <= key2) {
+        list.emplace_back(x->key, x->value());
+        x = x->nxt[0].load(std::memory_order_acquire);
+    }
+}
+
+class concurrent_skiplist_iter : public memiter {
+private:
+    csnode *cur;
+    csvalue *v = nullptr;
+
+    void load() {
+        if (cur)
+            v = cur->val.load(std::memory_order_acquire);
+    }
+
+public:
+    explicit concurrent_skiplist_iter(csnode *first) : cur(first) {
+        load();
+    }
+
+    bool valid() override {
+        return cur != nullptr;
+    }
+
+    void next() override {
+        cur = cur->nxt[0].load(std::memory_order_acquire);
+        load();
+    }
+
+    uint64_t key() override {
+        return cur->key;
+    }
+
+    const char *val() override {
+        return v->data;
+    }
+
+    uint32_t len() override {
+        return v->len;
+    }
+};
+
+std::unique_ptr<memiter> concurrent_skiplist::begin() {
+    return std::make_unique<concurrent_skiplist_iter>(getFirst());
+}
+
+csnode *concurrent_skiplist::lowerBound(uint64_t key) {
+    csnode *x = head;
+    csnode *prev, *next = nullptr;
+    for (int i = curMaxL.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+        findSplice(key, i, x, prev, next);
+        x = prev;
+    }
+    return next;
+}
+
+void concurrent_skiplist::reset() {
+    mem.reset();
+    init();
+}
+
+uint32_t concurrent_skiplist::getBytes() {
+    return bytes.load(std::memory_order_relaxed);
+}
+
+size_t concurrent_skiplist::memoryUsage() {
+    return mem.memoryUsage();
+}
@@ -0,0 +1,84 @@
+#ifndef LSM_KV_CONCURRENT_SKIPLIST_H
+#define LSM_KV_CONCURRENT_SKIPLIST_H
+
+#include "arena.h"
+#include "memtable.h"
+#include "skiplist.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// value 记录：写入序号 + 长度 + 内容，更新时整条替换，不在原地修改
+struct csvalue {
+    uint64_t seq; // 0 表示不比较序号，总是覆盖
+    uint32_t len;
+    char data[1];
+};
+
+class csnode {
+public:
+    uint64_t key;
+    std::atomic<csvalue *> val;
+    int level;
+    std::atomic<csnode *> nxt[1]; // 实际长度为 level
+
+    std::string value() const {
+        csvalue *v = val.load(std::memory_order_acquire);
+        return std::string(v->data, v->len);
+    }
+};
+
+/*
+ * 多写多读的跳表 memtable：
+ *  - 每一层用 CAS 把新节点接到前驱后面，先接第 0 层，节点一旦在第 0 层可见即视为插入完成；
+ *  - 读者不加锁，只依赖 acquire/release 顺序；
+ *  - 已存在的 key 通过 CAS 替换 value 指针更新，seq 更大的 value 才能替换，并发写同一个 key 时结果与日志一致；
+ *  - 节点从不摘除，内存随 arena 在 reset 时一起释放，find 返回的 value 在 reset 之前有效。
+ * reset 和 begin 不能与写入并发调用。单线程场景仍使用 skiplist。
+ */
+class concurrent_skiplist : public memtable {
+private:
+    std::atomic<int> curMaxL{1};
+    std::atomic<uint32_t> bytes{0}; // 与 skiplist 相同，表示 index + data 区域的字节数
+    concurrent_arena mem;
+    csnode *head = nullptr;
+
+    csnode *newNode(uint64_t key, int level);
+    csvalue *newValue(const std::string &str, uint64_t seq);
+    void init();
+    // 在第 level 层从 before 开始，找到 prev->key < key <= next->key 的位置
+    void findSplice(uint64_t key, int level, csnode *before, csnode *&prev, csnode *&next);
+    int64_t replaceValue(csnode *node, csvalue *val); // 更新已存在的 key，同时修正 bytes，返回 bytes 的变化量
+
+public:
+    concurrent_skiplist() {
+        init();
+    }
+
+    concurrent_skiplist(const concurrent_skiplist &) = delete;
+    concurrent_skiplist &operator=(const concurrent_skiplist &) = delete;
+
+    csnode *getFirst() {
+        return head->nxt[0].load(std::memory_order_acquire);
+    }
+
+    int randLevel();
+    void insert(uint64_t key, const std::string &str);                                  // 线程安全
+    int64_t upsertOrdered(uint64_t key, const std::string &str, uint64_t seq) override; // 线程安全，见 memtable.h
+    int64_t upsert(uint64_t key, const std::string &str) override;                      // 同 insert
+    bool find(uint64_t key, const char *&val, uint32_t &len) override;                  // 线程安全
+    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) override;
+    std::unique_ptr<memiter> begin() override;
+    csnode *lowerBound(uint64_t key);
+    void reset() override;
+    uint32_t getBytes() override;
+    size_t memoryUsage() override;
+
+    bool concurrent() override {
+        return true;
+    }
+};
+
+#endif // LSM_KV_CONCURRENT_SKIPLIST_H
@@ -1,8 +1,20 @@
+#include "tablebuilder.h"
 #include "test.h"
+#include "utils.h"
 
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <future>
 #include <iostream>
+#include <list>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 class CorrectnessTest : public Test {
 private:
@@ -135,6 +147,335 @@ private:
         report();
     }
 
+    void batch_test(uint64_t max) {
+        uint64_t i;
+        WriteBatch batch;
+
+        // Test a single batch
+        batch.put(1, "SE");
+        batch.put(2, "SE");
+        batch.del(2);
+        batch.put(3, "SE");
+        batch.put(3, "LSM");
+        EXPECT(5, batch.count());
+        store.write(batch);
+        EXPECT("SE", store.get(1));
+        EXPECT(not_found, store.get(2));
+        EXPECT("LSM", store.get(3));
+        batch.clear();
+        EXPECT(0, batch.count());
+
+        phase();
+
+        // Test multiple batches
+        for (i = 0; i < max; ++i) {
+            batch.put(i, std::string(i + 1, 'b'));
+            if (batch.count() == 100) {
+                store.write(batch);
+                batch.clear();
+            }
+        }
+        store.write(batch);
+        batch.clear();
+
+        for (i = 0; i < max; ++i)
+            EXPECT(std::string(i + 1, 'b'), store.get(i));
+
+        phase();
+
+        // Test deletions mixed with puts
+        for (i = 0; i < max; ++i) {
+            if (i & 1)
+                batch.del(i);
+            else
+                batch.put(i, std::string(i + 1, 'c'));
+            if (batch.count() == 100) {
+                store.write(batch);
+                batch.clear();
+            }
+        }
+        store.write(batch);
+
+        for (i = 0; i < max; ++i)
+            EXPECT((i & 1) ? not_found : std::string(i + 1, 'c'), store.get(i));
+
+        phase();
+
+        report();
+    }
+
+    void multiget_test(uint64_t max) {
+        uint64_t i;
+        std::vector<uint64_t> keys;
+        std::vector<std::string> values;
+
+        for (i = 0; i < max; ++i)
+            store.put(i, std::string(i + 1, 'm'));
+        for (i = 0; i < max; i += 3)
+            store.del(i);
+
+        // Test keys in random order, with duplicates and missing keys
+        for (i = 0; i < max; ++i)
+            keys.push_back(i * 7919 % (max + max / 4));
+        values = store.multiGet(keys);
+        EXPECT(keys.size(), values.size());
+        for (i = 0; i < keys.size(); ++i) {
+            uint64_t key      = keys[i];
+            std::string value = values[i];
+            EXPECT((key >= max || key % 3 == 0) ? not_found : std::string(key + 1, 'm'), value);
+        }
+
+        phase();
+
+        // Test small batches mixed with recent writes still in memory
+        for (i = 0; i < max; i += 5)
+            store.put(i, "MG");
+        for (i = 0; i + 64 <= max; i += 64) {
+            keys.assign(64, 0);
+            for (uint64_t j = 0; j < 64; ++j)
+                keys[j] = i + 63 - j;
+            values = store.multiGet(keys);
+            for (uint64_t j = 0; j < 64; ++j) {
+                std::string value = values[j];
+                EXPECT(store.get(keys[j]), value);
+            }
+        }
+
+        phase();
+
+        report();
+    }
+
+    void async_get_test(uint64_t max) {
+        uint64_t i;
+        std::vector<std::future<std::string>> futures;
+
+        for (i = 0; i < max; ++i)
+            store.put(i, std::string(i + 1, 'a'));
+        for (i = 0; i < max; i += 4)
+            store.del(i);
+
+        // Test many lookups in flight at once, including missing keys
+        for (i = 0; i < max + max / 4; ++i)
+            futures.push_back(store.getAsync(i));
+        for (i = 0; i < futures.size(); ++i) {
+            std::string value = futures[i].get();
+            EXPECT((i >= max || i % 4 == 0) ? not_found : std::string(i + 1, 'a'), value);
+        }
+
+        phase();
+
+        // Test callbacks against get after overwrites
+        for (i = 0; i < max; i += 3)
+            store.put(i, "AG");
+        std::vector<std::string> values(max);
+        std::atomic<uint64_t> done(0);
+        for (i = 0; i < max; ++i) {
+            store.getAsync(i, [&values, &done, i](std::string value) {
+                values[i] = std::move(value);
+                done++;
+            });
+        }
+        while (done < max)
+            std::this_thread::yield();
+        for (i = 0; i < max; ++i) {
+            std::string value = values[i];
+            EXPECT(store.get(i), value);
+        }
+
+        phase();
+
+        report();
+    }
+
+    void level_filter_test(uint64_t max) {
+        uint64_t i;
+
+        // Even keys in a shuffled order, so every table spans the whole key range
+        for (i = 0; i < max; ++i)
+            store.put(2 * (i * 7919 % max), std::string(64, 'f'));
+        store.waitFlushed();
+
+        // Test absent keys inside the key range are skipped by the level filters
+        uint64_t skips = store.getStats().levelSkips;
+        for (i = 0; i + 1 < max; ++i)
+            EXPECT(not_found, store.get(2 * i + 1));
+        EXPECT(true, store.getStats().levelSkips - skips >= max * 9 / 10);
+        std::vector<uint64_t> keys;
+        for (i = 0; i + 1 < max; ++i)
+            keys.push_back(2 * i + 1);
+        skips = store.getStats().levelSkips;
+        std::vector<std::string> values = store.multiGet(keys);
+        for (i = 0; i < keys.size(); ++i) {
+            std::string value = values[i];
+            EXPECT(not_found, value);
+        }
+        EXPECT(true, store.getStats().levelSkips - skips >= max * 9 / 10);
+
+        phase();
+
+        // Test filters rebuilt by compaction still pass every present key
+        for (i = 0; i < max; i += 2)
+            store.put(2 * i, "LF");
+        store.waitFlushed();
+        for (i = 0; i < max; ++i)
+            EXPECT(i % 2 ? std::string(64, 'f') : "LF", store.get(2 * i));
+
+        phase();
+
+        report();
+    }
+
+    void valueref_test(uint64_t max) {
+        uint64_t i;
+        std::vector<valueref> refs(max);
+
+        for (i = 0; i < max; ++i)
+            store.put(i, std::string(i + 1, 'r'));
+        for (i = 0; i < max; i += 2)
+            store.del(i);
+
+        // Test get into a value handle
+        for (i = 0; i < max; ++i) {
+            bool found = store.get(i, refs[i]);
+            EXPECT(i % 2 == 1, found);
+            if (found) {
+                std::string value = refs[i].toString();
+                EXPECT(std::string(i + 1, 'r'), value);
+            }
+        }
+        valueref missing;
+        for (i = max; i < max + 16; ++i) {
+            bool found = store.get(i, missing);
+            EXPECT(false, found);
+        }
+
+        phase();
+
+        // Test handles stay valid after their tables are compacted away
+        for (i = 0; i < max; ++i)
+            store.put(i, std::string(i + 1, 'R'));
+        for (i = 1; i < max; i += 2) {
+            std::string value = refs[i].toString();
+            EXPECT(std::string(i + 1, 'r'), value);
+        }
+        refs.clear();
+
+        phase();
+
+        // Test scan into a vector and into a callback
+        std::list<std::pair<uint64_t, std::string>> list;
+        std::vector<std::pair<uint64_t, valueref>> vec;
+        store.scan(max / 4, max / 2, list);
+        store.scan(max / 4, max / 2, vec);
+        EXPECT(list.size(), vec.size());
+        auto it = list.begin();
+        for (i = 0; i < vec.size() && it != list.end(); ++i, ++it) {
+            EXPECT(it->first, vec[i].first);
+            std::string value = vec[i].second.toString();
+            EXPECT(it->second, value);
+        }
+        uint64_t count = 0;
+        store.scan(0, max, [&count](uint64_t, const valueref &) {
+            count++;
+            return count < 100; // stop early
+        });
+        EXPECT(100, count);
+
+        phase();
+
+        report();
+    }
+
+    // Write keys [0, max) in the block format from before the delta-encoded index:
+    // fixed-width block entries and block index, no checksums
+    static bool write_fixed_index_table(const std::string &path, uint64_t max) {
+        std::string file, block, index;
+        std::vector<uint32_t> restarts;
+        uint32_t entries = 0; // entries in the current block
+        bloom filter;
+        auto finish_block = [&](uint64_t last) {
+            for (uint32_t r : restarts)
+                block.append(reinterpret_cast<const char *>(&r), 4);
+            uint32_t n = restarts.size();
+            block.append(reinterpret_cast<const char *>(&n), 4);
+            uint32_t offset = file.size(), size = block.size();
+            index.append(reinterpret_cast<const char *>(&last), 8);
+            index.append(reinterpret_cast<const char *>(&offset), 4);
+            index.append(reinterpret_cast<const char *>(&size), 4);
+            file.append(block);
+            block.clear();
+            restarts.clear();
+            entries = 0;
+        };
+        for (uint64_t i = 0; i < max; ++i) {
+            std::string value(i % 64 + 1, 'f');
+            uint32_t len = value.size();
+            if (entries++ % RESTART_INTERVAL == 0)
+                restarts.push_back(block.size());
+            block.append(reinterpret_cast<const char *>(&i), 8);
+            block.append(reinterpret_cast<const char *>(&len), 4);
+            block.append(value);
+            filter.insert(i);
+            if (block.size() >= BLOCK_SIZE || i + 1 == max)
+                finish_block(i);
+        }
+        uint32_t filter_offset = file.size(), index_offset = filter_offset + M, count = index.size() / BLOCK_ENTRY;
+        uint32_t flags         = 0;
+        uint64_t time          = 1, cnt = max, min = 0, last = max - 1;
+        file.append(filter.data(), M);
+        file.append(index);
+        for (uint64_t v : {time, cnt, min, last})
+            file.append(reinterpret_cast<const char *>(&v), 8);
+        for (uint32_t v : {filter_offset, index_offset, count, flags})
+            file.append(reinterpret_cast<const char *>(&v), 4);
+        file.append(reinterpret_cast<const char *>(&TABLE_MAGIC), 8);
+        FILE *f = fopen(path.c_str(), "wb");
+        bool ok = f && fwrite(file.data(), 1, file.size(), f) == file.size();
+        return f && fclose(f) == 0 && ok;
+    }
+
+    void format_test(uint64_t max) {
+        std::string new_path = "./data/format-new.sst", old_path = "./data/format-old.sst";
+
+        // Test one head reused across tables, as when a level is loaded,
+        // does not carry checksums over to a table without them
+        tablebuilder builder(new_path, 1);
+        for (uint64_t i = 0; i < max; ++i)
+            builder.add(i, "checksummed", 11);
+        EXPECT(true, builder.finish());
+        EXPECT(true, write_fixed_index_table(old_path, max));
+        sstablehead head;
+        EXPECT(true, head.loadFileHead(new_path.c_str()));
+        EXPECT(true, head.hasChecksums());
+        EXPECT(true, head.loadFileHead(old_path.c_str()));
+        EXPECT(false, head.hasChecksums());
+
+        phase();
+
+        // Test the old table reads back through its block index
+        uint64_t count = 0;
+        FILE *f        = fopen(old_path.c_str(), "rb");
+        for (int p = 0; f && p < head.blockCount(); ++p) {
+            BlockIndex b = head.getBlock(p);
+            auto data    = std::make_shared<std::string>(b.size, '\0');
+            if (fseek(f, b.offset, SEEK_SET) != 0 || fread(data->data(), 1, b.size, f) != b.size)
+                break;
+            blockiter it(data);
+            for (it.seekToFirst(); it.valid(); it.next(), ++count)
+                EXPECT(std::string(count % 64 + 1, 'f'), it.value());
+        }
+        if (f)
+            fclose(f);
+        EXPECT(max, count);
+        std::remove(new_path.c_str());
+        std::remove(old_path.c_str());
+
+        phase();
+
+        report();
+    }
+
 public:
     CorrectnessTest(const std::string &dir, bool v = true) : Test(dir, v) {}
 
@@ -151,6 +492,34 @@ public:
         std::cout << "[Large Test]" << std::endl;
         regular_test(1024 * 64);
 
+        store.reset();
+
+        std::cout << "[Batch Test]" << std::endl;
+        batch_test(1024 * 16);
+
+        store.reset();
+
+        std::cout << "[MultiGet Test]" << std::endl;
+        multiget_test(1024 * 16);
+
+        store.reset();
+
+        std::cout << "[Async Get Test]" << std::endl;
+        async_get_test(1024 * 16);
+
+        store.reset();
+
+        std::cout << "[Level Filter Test]" << std::endl;
+        level_filter_test(1024 * 64);
+
+        store.reset();
+
+        std::cout << "[Value Ref Test]" << std::endl;
+        valueref_test(1024 * 16);
+
+        std::cout << "[Format Test]" << std::endl;
+        format_test(1024 * 4);
+
         //        store.reset();
         //        std::cout << "[Insert Test]" << std::endl;
         //        insert_test(1024 * 16);
@@ -161,6 +530,430 @@ public:
     }
 };
 
+/*
+ * Damages data blocks on disk and checks that reads report an error instead of a miss,
+ * and that compaction keeps its inputs instead of merging past the damaged block.
+ */
+class CorruptionTest : public Test {
+private:
+    static const uint64_t FILL       = 1ull << 32; // filler keys sort after all test keys
+    static const uint32_t VALUE_SIZE = 100;
+
+    std::string name;
+    Options options;
+    uint64_t filled = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> damaged; // key ranges of the damaged blocks
+
+    static std::string old_value(uint64_t i) {
+        return std::string(VALUE_SIZE + i % 7, 'o');
+    }
+
+    static std::string new_value(uint64_t i) {
+        return std::string(VALUE_SIZE + i % 5, 'n');
+    }
+
+    bool in_damaged_block(uint64_t key) const {
+        for (auto &range : damaged) {
+            if (key >= range.first && key <= range.second)
+                return true;
+        }
+        return false;
+    }
+
+    static std::vector<std::string> level0_tables() {
+        std::vector<std::string> files, res;
+        if (utils::dirExists("./data/level-0"))
+            utils::scanDir("./data/level-0", files);
+        for (const std::string &file : files) {
+            if (file.size() > 4 && file.substr(file.size() - 4) == ".sst")
+                res.push_back("./data/level-0/" + file);
+        }
+        return res;
+    }
+
+    // Write filler keys until pred() holds once everything that filled a memtable is flushed
+    template <typename F>
+    void fill_until(F pred) {
+        do {
+            for (int i = 0; i < 64; ++i, ++filled)
+                store.put(FILL + filled, std::string(VALUE_SIZE, 'x'));
+            store.waitFlushed();
+        } while (!pred());
+    }
+
+    // Flip bits in the last byte of the first block of a table: the restart count, or the compression type
+    static bool corrupt_first_block(const std::string &path, uint64_t &first, uint64_t &last) {
+        sstablehead head;
+        if (!head.loadFileHead(path.c_str()) || head.getFormat() != TABLE_BLOCK)
+            return false;
+        BlockIndex b = head.getBlock(0);
+        first        = head.getMinV();
+        last         = b.lastKey;
+        FILE *f      = fopen(path.c_str(), "r+b");
+        if (!f)
+            return false;
+        // A compressed block gets a wrong uncompressed length, so it fails to decode even without checksums
+        long offset = head.isCompressed() ? b.offset : b.offset + b.size - 1;
+        int c       = fseek(f, offset, SEEK_SET) == 0 ? fgetc(f) : EOF;
+        bool ok     = c != EOF && fseek(f, offset, SEEK_SET) == 0 && fputc(c ^ 0x5a, f) != EOF;
+        return fclose(f) == 0 && ok;
+    }
+
+    void corruption_test(uint64_t max) {
+        uint64_t i;
+        // keys in one memtable (each takes its value, up to 6 more bytes and 12 bytes of accounting),
+        // so the updated keys are flushed in at most two tables
+        const uint64_t table_keys = (options.tableSize - 10240 - 32) / (VALUE_SIZE + 6 + 12);
+        const uint64_t updated    = table_keys;
+
+        // Old values end up below level-0, new values for the first keys in level-0 tables
+        for (i = 0; i < max; ++i)
+            store.put(i, old_value(i));
+        uint64_t start = filled;
+        fill_until([&] { return filled - start > table_keys && level0_tables().empty(); });
+        for (i = 0; i < updated; ++i)
+            store.put(i, new_value(i));
+        fill_until([&] { return level0_tables().size() >= 2; });
+
+        std::vector<std::string> tables = level0_tables();
+        std::vector<uint64_t> broken; // updated keys in a damaged block
+        damaged.clear();
+        for (const std::string &path : tables) {
+            uint64_t first = 0, last = 0;
+            EXPECT(true, corrupt_first_block(path, first, last));
+            damaged.emplace_back(first, last);
+            for (i = first; i <= last && i < updated; ++i)
+                broken.push_back(i);
+        }
+        std::sort(broken.begin(), broken.end());
+        EXPECT(true, !broken.empty());
+
+        phase();
+
+        // Test point reads report the damaged block instead of an older value
+        uint64_t errors = store.getStats().readErrors;
+        valueref ref;
+        for (uint64_t key : broken) {
+            EXPECT(READ_CORRUPTED, store.lookup(key, ref));
+            EXPECT(not_found, store.get(key));
+        }
+        std::vector<READ_STATUS> status;
+        std::vector<std::string> values = store.multiGet(broken, status);
+        for (i = 0; i < broken.size(); ++i) {
+            READ_STATUS st    = status[i];
+            std::string value = values[i];
+            EXPECT(READ_CORRUPTED, st);
+            EXPECT(not_found, value);
+        }
+        for (uint64_t key : broken) {
+            auto promise = std::make_shared<std::promise<READ_STATUS>>();
+            store.getAsync(key, [promise](READ_STATUS st, std::string) { promise->set_value(st); });
+            EXPECT(READ_CORRUPTED, promise->get_future().get());
+        }
+        EXPECT(errors + 4 * broken.size(), store.getStats().readErrors);
+        // Other blocks are still readable
+        for (i = 0; i < max; ++i) {
+            if (!in_damaged_block(i))
+                EXPECT(i < updated ? new_value(i) : old_value(i), store.get(i));
+        }
+
+        phase();
+
+        // Test scan stops at the damaged block instead of returning older values
+        std::list<std::pair<uint64_t, std::string>> list;
+        store.scan(0, max, list);
+        for (auto &p : list)
+            EXPECT(false, p.first < updated && p.second == old_value(p.first));
+        EXPECT(true, store.getStats().readErrors > errors + 4 * broken.size());
+
+        phase();
+
+        // Test compaction keeps its inputs instead of merging past the damaged block
+        uint64_t compactions = store.getStats().compactions;
+        fill_until([&] { return level0_tables().size() > 2 || store.getStats().compactions != compactions; });
+        EXPECT(compactions, store.getStats().compactions);
+        std::vector<std::string> left = level0_tables();
+        for (const std::string &path : tables)
+            EXPECT(true, std::find(left.begin(), left.end(), path) != left.end());
+        for (uint64_t key : broken)
+            EXPECT(READ_CORRUPTED, store.lookup(key, ref));
+        for (i = 0; i < max; ++i) {
+            if (!in_damaged_block(i))
+                EXPECT(i < updated ? new_value(i) : old_value(i), store.get(i));
+        }
+        for (i = 0; i < filled; ++i) {
+            if (!in_damaged_block(FILL + i))
+                EXPECT(std::string(VALUE_SIZE, 'x'), store.get(FILL + i));
+        }
+
+        phase();
+
+        report();
+    }
+
+public:
+    CorruptionTest(const std::string &dir, const std::string &name, const Options &options, bool v = true) :
+        Test(dir, v, options),
+        name(name),
+        options(options) {}
+
+    void start_test(void *args = NULL) override {
+        std::cout << "[" << name << "]" << std::endl;
+        store.reset();
+        corruption_test(1024 * 4);
+        store.reset();
+    }
+};
+
+/*
+ * The store is reopened after a crash: a forked child writes through its own KVStore and exits
+ * without closing it, so everything it wrote is only in the write-ahead log.
+ */
+class WalTest : public Test {
+private:
+    std::string name;
+    Options options;
+
+    static std::string value(uint64_t i) {
+        return std::string(i % 50 + 1, 'w');
+    }
+
+    static std::vector<std::string> logs() {
+        std::vector<std::string> files, res;
+        if (utils::dirExists("./data/wal"))
+            utils::scanDir("./data/wal", files);
+        for (const std::string &file : files) {
+            if (file.size() > 4 && file.substr(file.size() - 4) == ".log")
+                res.push_back("./data/wal/" + file);
+        }
+        return res;
+    }
+
+    // Run work on a store in a child process that exits without closing it, like a crash
+    template <typename F>
+    bool crash_after(F work) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            KVStore db("./data", options);
+            work(db);
+            _exit(0);
+        }
+        int status = 0;
+        return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // Cut bytes off the end of a log, as if the crash hit while its final record was being written
+    static bool tear(const std::string &path, off_t bytes) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && truncate(path.c_str(), st.st_size - bytes) == 0;
+    }
+
+    void wal_test(uint64_t max) {
+        uint64_t i;
+
+        // Test that unflushed puts and deletes are replayed on reopen
+        EXPECT(true, crash_after([max](KVStore &db) {
+            for (uint64_t i = 0; i < max; ++i)
+                db.put(i, value(i));
+            for (uint64_t i = 0; i < max; i += 3)
+                db.del(i);
+        }));
+        EXPECT(1, logs().size());
+        {
+            KVStore db("./data", options);
+            for (i = 0; i < max; ++i)
+                EXPECT(i % 3 ? value(i) : not_found, db.get(i));
+            EXPECT(0, db.getStats().flushes);
+            db.reset();
+        }
+
+        phase();
+
+        // Test that a torn final record is dropped and every record before it is replayed
+        EXPECT(true, crash_after([max](KVStore &db) {
+            for (uint64_t i = 0; i <= max; ++i)
+                db.put(i, value(i));
+        }));
+        std::vector<std::string> files = logs();
+        EXPECT(1, files.size());
+        EXPECT(true, !files.empty() && tear(files[0], 1));
+        {
+            KVStore db("./data", options);
+            for (i = 0; i < max; ++i)
+                EXPECT(value(i), db.get(i));
+            EXPECT(not_found, db.get(max));
+            db.reset();
+        }
+
+        phase();
+
+        // Test that the replayed log, and each later one, is deleted once its memtable is flushed
+        EXPECT(true, crash_after([max](KVStore &db) {
+            for (uint64_t i = 0; i < max; ++i)
+                db.put(i, value(i));
+        }));
+        files = logs();
+        EXPECT(1, files.size());
+        {
+            KVStore db("./data", options);
+            std::vector<std::string> reopened = logs();
+            EXPECT(1, reopened.size());
+            EXPECT(true, reopened != files);
+            for (i = 0; i < 8 * max; ++i)
+                db.put(max + i, std::string(256, 'f'));
+            db.waitFlushed();
+            EXPECT(true, db.getStats().flushes > 1);
+            std::vector<std::string> current = logs();
+            EXPECT(1, current.size());
+            EXPECT(true, current != reopened);
+            for (i = 0; i < max; ++i)
+                EXPECT(value(i), db.get(i));
+            db.reset();
+        }
+        EXPECT(0, logs().size());
+
+        phase();
+
+        report();
+    }
+
+public:
+    WalTest(const std::string &dir, const std::string &name, const Options &options, bool v = true) :
+        Test(dir, v, options),
+        name(name),
+        options(options) {}
+
+    void start_test(void *args = NULL) override {
+        std::cout << "[" << name << "]" << std::endl;
+        store.reset();
+        wal_test(512);
+        store.reset();
+    }
+};
+
+/*
+ * Several threads put and delete at once, with small tables so that memtables rotate and
+ * flush while inserts are still in flight. Run against every Options::memtable type.
+ */
+class ConcurrentTest : public Test {
+private:
+    static const int THREADS = 4;
+    static const int ROUNDS  = 8;
+
+    std::string name;
+
+    template <class F>
+    static void run_threads(F &&work) {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; ++t)
+            workers.emplace_back([&work, t] { work(t); });
+        for (auto &w : workers)
+            w.join();
+    }
+
+    static std::string tag(int thread, int round) {
+        return std::to_string(thread) + ":" + std::to_string(round) + std::string(48, 'c');
+    }
+
+    void concurrent_test(uint64_t max, uint64_t shared) {
+        uint64_t i;
+
+        // Test threads putting disjoint keys
+        run_threads([&](int t) {
+            for (uint64_t k = t; k < max; k += THREADS)
+                store.put(k, std::string(k % 64 + 1, 'c'));
+        });
+        for (i = 0; i < max; ++i)
+            EXPECT(std::string(i % 64 + 1, 'c'), store.get(i));
+        std::list<std::pair<uint64_t, std::string>> list;
+        store.scan(0, max, list);
+        EXPECT(max, list.size());
+
+        phase();
+
+        // Test threads overwriting the same keys end with the last value one of them wrote
+        run_threads([&](int t) {
+            for (int r = 0; r < ROUNDS; ++r) {
+                for (uint64_t k = 0; k < shared; ++k)
+                    store.put(k, tag(t, r));
+            }
+        });
+        std::vector<uint64_t> keys(shared);
+        std::vector<std::string> values(shared);
+        for (i = 0; i < shared; ++i) {
+            keys[i]   = i;
+            values[i] = store.get(i);
+            bool last = false;
+            for (int t = 0; t < THREADS; ++t)
+                last = last || values[i] == tag(t, ROUNDS - 1);
+            EXPECT(true, last);
+        }
+        std::vector<std::string> batch = store.multiGet(keys);
+        for (i = 0; i < shared; ++i) {
+            std::string value = batch[i];
+            EXPECT(values[i], value);
+        }
+
+        phase();
+
+        // Test concurrent deletes next to concurrent puts
+        run_threads([&](int t) {
+            for (uint64_t k = t; k < max; k += THREADS) {
+                if (k % 2 == 0)
+                    store.del(k);
+                else
+                    store.put(k, std::string(k % 64 + 2, 'd'));
+            }
+        });
+        store.waitFlushed();
+        for (i = 0; i < max; ++i)
+            EXPECT(i % 2 ? std::string(i % 64 + 2, 'd') : not_found, store.get(i));
+
+        phase();
+
+        // Test reset while other threads are still putting, then that nothing survives the last reset
+        std::atomic<bool> putting{true};
+        std::thread resetter([&] {
+            do
+                store.reset();
+            while (putting);
+        });
+        run_threads([&](int t) {
+            for (uint64_t k = t; k < max; k += THREADS)
+                store.put(k, std::string(k % 64 + 3, 'r'));
+        });
+        putting = false;
+        resetter.join();
+        store.reset();
+        list.clear();
+        store.scan(0, max, list);
+        EXPECT(0, list.size());
+        run_threads([&](int t) {
+            for (uint64_t k = t; k < max; k += THREADS)
+                store.put(k, std::string(k % 64 + 1, 'c'));
+        });
+        for (i = 0; i < max; ++i)
+            EXPECT(std::string(i % 64 + 1, 'c'), store.get(i));
+
+        phase();
+
+        report();
+    }
+
+public:
+    ConcurrentTest(const std::string &dir, const std::string &name, const Options &options, bool v = true) :
+        Test(dir, v, options),
+        name(name) {}
+
+    void start_test(void *args = NULL) override {
+        std::cout << "[" << name << "]" << std::endl;
+        store.reset();
+        concurrent_test(1024 * 16, 512);
+        store.reset();
+    }
+};
+
 int main(int argc, char *argv[]) {
     bool verbose = (argc == 2 && std::string(argv[1]) == "-v");
 
@@ -170,9 +963,45 @@ int main(int argc, char *argv[]) {
     std::cout << std::endl;
     std::cout.flush();
 
-    CorrectnessTest test("./data", verbose);
+    {
+        CorrectnessTest test("./data", verbose);
+
+        test.start_test();
+    }
 
-    test.start_test();
+    std::cout << std::endl << "KVStore Corruption Test" << std::endl;
+
+    Options options;
+    options.tableSize       = 64 * 1024; // a few thousand keys fill several levels
+    options.verifyChecksums = true;
+    CorruptionTest("./data", "Checksum Test", options, verbose).start_test();
+    options.mmapReads = true;
+    CorruptionTest("./data", "Checksum Test (mmap)", options, verbose).start_test();
+    options.verifyChecksums = false;
+    options.mmapReads       = false;
+    options.compression     = COMPRESSION_FAST;
+    CorruptionTest("./data", "Decompression Test", options, verbose).start_test();
+    options.mmapReads = true;
+    CorruptionTest("./data", "Decompression Test (mmap)", options, verbose).start_test();
+
+    std::cout << std::endl << "KVStore Recovery Test" << std::endl;
+
+    options           = Options();
+    options.tableSize = 64 * 1024;
+    WalTest("./data", "WAL Replay Test", options, verbose).start_test();
+
+    std::cout << std::endl << "KVStore Concurrent Write Test" << std::endl;
+
+    options           = Options();
+    options.tableSize = 64 * 1024;
+    options.memtable  = MEMTABLE_CONCURRENT;
+    ConcurrentTest("./data", "Concurrent Memtable Test", options, verbose).start_test();
+    options.memtable = MEMTABLE_SKIPLIST;
+    ConcurrentTest("./data", "Skiplist Memtable Test", options, verbose).start_test();
+    options.memtable = MEMTABLE_HASH_SKIPLIST;
+    ConcurrentTest("./data", "Hash Skiplist Memtable Test", options, verbose).start_test();
+    options.memtable = MEMTABLE_VECTOR;
+    ConcurrentTest("./data", "Vector Memtable Test", options, verbose).start_test();
 
     return 0;
 }
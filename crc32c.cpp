@@ -0,0 +1,96 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86
+#endif
+
+namespace crc32c {
+namespace {
+const uint32_t POLY = 0x82f63b78; // 反射后的多项式
+
+struct tables {
+    uint32_t t[8][256]; // t[k][b]：字节 b 后面再跟 k 个 0 字节的 crc
+
+    tables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t c = b;
+            for (int i = 0; i < 8; ++i)
+                c = (c >> 1) ^ (c & 1 ? POLY : 0);
+            t[0][b] = c;
+        }
+        for (uint32_t b = 0; b < 256; ++b)
+            for (int k = 1; k < 8; ++k)
+                t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+    }
+};
+
+const tables &table() {
+    static const tables res;
+    return res;
+}
+
+uint32_t extendTable(uint32_t crc, const char *data, size_t n) {
+    const tables &tb = table();
+    const auto *p    = reinterpret_cast<const unsigned char *>(data);
+    uint32_t c       = ~crc;
+    while (n >= 8) { // 一次处理 8 字节（slicing-by-8），要求小端
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= c;
+        c = tb.t[7][lo & 0xff] ^ tb.t[6][(lo >> 8) & 0xff] ^ tb.t[5][(lo >> 16) & 0xff] ^ tb.t[4][lo >> 24] ^
+            tb.t[3][hi & 0xff] ^ tb.t[2][(hi >> 8) & 0xff] ^ tb.t[1][(hi >> 16) & 0xff] ^ tb.t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--)
+        c = (c >> 8) ^ tb.t[0][(c ^ *p++) & 0xff];
+    return ~c;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2"))) uint32_t extendHardware(uint32_t crc, const char *data, size_t n) {
+    const auto *p = reinterpret_cast<const unsigned char *>(data);
+    uint64_t c    = ~crc;
+#if defined(__x86_64__)
+    while (n >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        n -= 8;
+    }
+#endif
+    uint32_t c32 = (uint32_t)c;
+    while (n--)
+        c32 = _mm_crc32_u8(c32, *p++);
+    return ~c32;
+}
+#endif
+
+bool detect() {
+#ifdef CRC32C_X86
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+const bool useHardware = detect();
+} // namespace
+
+uint32_t extend(uint32_t crc, const char *data, size_t n) {
+#ifdef CRC32C_X86
+    if (useHardware)
+        return extendHardware(crc, data, n);
+#endif
+    return extendTable(crc, data, n);
+}
+
+bool hardware() {
+    return useHardware;
+}
+} // namespace crc32c
@@ -0,0 +1,21 @@
+#ifndef LSM_KV_CRC32C_H
+#define LSM_KV_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * CRC32C（Castagnoli 多项式，与 iSCSI、ext4 相同），sstable 的校验和。
+ * x86 上支持 SSE4.2 时用 crc32 指令，每周期处理 8 字节；否则查表，一次处理 8 字节。
+ */
+namespace crc32c {
+uint32_t extend(uint32_t crc, const char *data, size_t n); // 在 crc 的基础上继续算 data
+
+inline uint32_t value(const char *data, size_t n) {
+    return extend(0, data, n);
+}
+
+bool hardware(); // 是否在用硬件指令
+} // namespace crc32c
+
+#endif // LSM_KV_CRC32C_H
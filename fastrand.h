@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * xorshift64* 伪随机数发生器，只有一个 64 位状态，不是线程安全的，
+ * 每个跳表（或每个线程）各持有一个。相同的种子产生相同的序列，跳表的形状可以复现。
+ */
+class fastrand {
+private:
+    uint64_t state;
+
+public:
+    explicit fastrand(uint64_t seed) {
+        // splitmix64 打散种子，避免种子为 0 或相近的种子产生相关的序列
+        seed += 0x9E3779B97F4A7C15ULL;
+        seed  = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        seed  = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+        state = (seed ^ (seed >> 31)) | 1;
+    }
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    /*
+     * 跳表的层数：每层以 2^-bitsPerLevel 的概率继续增长，
+     * 等价于数末尾连续的 0 的个数，一次生成代替逐层掷硬币。
+     */
+    int level(int bitsPerLevel, int maxLevel) {
+        int level = 1 + __builtin_ctzll(next() | (1ULL << 63)) / bitsPerLevel;
+        return level < maxLevel ? level : maxLevel;
+    }
+};
@@ -0,0 +1,59 @@
+#include "kvstore.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+/*
+ * memtable 落盘大小测试：
+ * 对每种 value 长度写入同样总量的数据，统计 level-0 sstable 的个数、平均大小、
+ * 落盘前 memtable 占用的内存，以及 compaction 发生的次数。
+ * sstable 的大小由 Options::tableSize 决定，可以通过第二个参数修改。
+ */
+
+int main(int argc, char *argv[]) {
+    uint64_t totalMB = 32;
+    Options options;
+    if (argc >= 2)
+        totalMB = std::stoull(argv[1]);
+    if (argc >= 3)
+        options.tableSize = std::stoul(argv[2]) * 1024;
+
+    std::cout << "Usage: " << argv[0] << " [total MB] [table size KB]" << std::endl;
+    std::cout << "total: " << totalMB << "MB, table size: " << options.tableSize / 1024 << "KB" << std::endl
+              << std::endl;
+
+    std::cout << std::left << std::setw(12) << "value size" << std::setw(10) << "flushes" << std::setw(16)
+              << "avg L0 (KB)" << std::setw(20) << "avg memtable (KB)" << std::setw(14) << "compactions"
+              << std::setw(12) << "put (s)" << std::endl;
+
+    for (uint64_t valueSize : {16, 128, 1024, 4096}) {
+        KVStore store("./data", options);
+        store.reset();
+        KVStore::Stats before = store.getStats();
+
+        uint64_t n = totalMB * 1024 * 1024 / valueSize;
+        std::mt19937_64 rng(valueSize);
+        const std::string value(valueSize, 'v');
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < n; ++i)
+            store.put(rng(), value);
+        store.waitFlushed();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        KVStore::Stats after = store.getStats();
+        uint64_t flushes     = after.flushes - before.flushes;
+        double avgTable      = flushes ? (after.flushBytes - before.flushBytes) / 1024.0 / flushes : 0;
+        double avgMemory     = flushes ? (after.flushMemory - before.flushMemory) / 1024.0 / flushes : 0;
+
+        std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(12) << valueSize << std::setw(10)
+                  << flushes << std::setw(16) << avgTable << std::setw(20) << avgMemory << std::setw(14)
+                  << after.compactions - before.compactions << std::setw(12)
+                  << std::chrono::duration<double>(end - start).count() << std::endl;
+        store.reset();
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include "hash_skiplist.h"
+
+int64_t hash_skiplist::upsert(uint64_t key, const std::string &str) {
+    auto it = index.find(key);
+    if (it != index.end())
+        return list.replaceValue(it->second, str);
+    slnode *node;
+    int64_t delta = list.upsert(key, str, &node);
+    index.emplace(key, node);
+    return delta;
+}
+
+bool hash_skiplist::find(uint64_t key, const char *&val, uint32_t &len) {
+    auto it = index.find(key);
+    if (it == index.end())
+        return false;
+    val = it->second->val;
+    len = it->second->len;
+    return true;
+}
+
+void hash_skiplist::scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) {
+    this->list.scan(key1, key2, list);
+}
+
+std::unique_ptr<memiter> hash_skiplist::begin() {
+    return list.begin();
+}
+
+void hash_skiplist::reset() {
+    list.reset();
+    index.clear();
+}
+
+uint32_t hash_skiplist::getBytes() {
+    return list.getBytes();
+}
+
+size_t hash_skiplist::memoryUsage() {
+    // 哈希表的内存按每个桶一个指针、每个表项一个链表节点估算
+    size_t node = sizeof(void *) + sizeof(std::pair<const uint64_t, slnode *>) + sizeof(size_t);
+    return list.memoryUsage() + index.bucket_count() * sizeof(void *) + index.size() * node;
+}
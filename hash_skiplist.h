@@ -0,0 +1,31 @@
+#ifndef LSM_KV_HASH_SKIPLIST_H
+#define LSM_KV_HASH_SKIPLIST_H
+
+#include "memtable.h"
+#include "skiplist.h"
+
+#include <unordered_map>
+
+/*
+ * 跳表加一张 key -> 节点 的哈希表：
+ * 点查和更新已有的 key 直接走哈希表，不再从跳表顶层往下找；
+ * scan 和落盘仍然按跳表的顺序遍历。代价是每个 key 多一个哈希表项的内存。
+ */
+class hash_skiplist : public memtable {
+private:
+    skiplist list;
+    std::unordered_map<uint64_t, slnode *> index;
+
+public:
+    hash_skiplist() : list(0.5) {}
+
+    int64_t upsert(uint64_t key, const std::string &str) override;
+    bool find(uint64_t key, const char *&val, uint32_t &len) override;
+    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) override;
+    std::unique_ptr<memiter> begin() override;
+    void reset() override;
+    uint32_t getBytes() override;
+    size_t memoryUsage() override;
+};
+
+#endif // LSM_KV_HASH_SKIPLIST_H
@@ -0,0 +1,208 @@
+#include "ioqueue.h"
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+static thread_local bool inCallback = false; // 当前线程是否在执行完成回调
+
+static int uringSetup(unsigned entries, io_uring_params *p) {
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+// 同步读满 len 字节，返回读到的字节数或 -errno
+static ssize_t preadFull(int fd, char *buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -errno;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+ioqueue::ioqueue(unsigned depth, bool useUring) : depth(std::max(depth, 1u)) {
+    if (useUring && setupRing()) {
+        reaper = std::thread(&ioqueue::reapLoop, this);
+        return;
+    }
+    pool = std::make_unique<ThreadPool>(std::min(this->depth, 16u));
+}
+
+ioqueue::~ioqueue() {
+    std::unique_lock<std::mutex> guard(lock);
+    slotCond.wait(guard, [this] { return inflight == 0; });
+    if (ringFd < 0) {
+        guard.unlock();
+        pool.reset();
+        return;
+    }
+    while (!submit(IORING_OP_NOP, nullptr, -1, 0)) // user_data 为 0，通知 reaper 退出
+        std::this_thread::yield();
+    guard.unlock();
+    reaper.join();
+    ::munmap(sqes, sqesSize);
+    if (cqRing != sqRing)
+        ::munmap(cqRing, cqRingSize);
+    ::munmap(sqRing, sqRingSize);
+    ::close(ringFd);
+}
+
+bool ioqueue::setupRing() {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    int fd = uringSetup(depth, &p);
+    if (fd < 0) // 老内核、seccomp 或 sysctl 禁用时都会失败，退回线程池
+        return false;
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    cqRing = sqRing;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cqRing = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            ::munmap(sqRing, sqRingSize);
+            ::close(fd);
+            return false;
+        }
+    }
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    void *s  = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) {
+        if (cqRing != sqRing)
+            ::munmap(cqRing, cqRingSize);
+        ::munmap(sqRing, sqRingSize);
+        ::close(fd);
+        return false;
+    }
+
+    char *sq  = static_cast<char *>(sqRing);
+    char *cq  = static_cast<char *>(cqRing);
+    sqHead    = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sqTail    = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sqMask    = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sqArray   = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    sqes      = static_cast<io_uring_sqe *>(s);
+    cqHead    = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cqTail    = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cqMask    = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes      = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    depth     = std::min(depth, p.sq_entries); // 在途请求不超过 sq_entries，完成队列（2 倍大小）不会溢出
+    ringFd    = fd;
+    return true;
+}
+
+void ioqueue::read(int fd, char *buf, size_t len, uint64_t offset, callback cb) {
+    request *req = new request{{buf, len}, std::move(cb)};
+    std::unique_lock<std::mutex> guard(lock);
+    // 回调中继续提交的请求不等待，否则所有名额都被等待者占住时没有人能完成
+    if (!inCallback)
+        slotCond.wait(guard, [this] { return inflight < depth; });
+    inflight++;
+    if (ringFd >= 0) {
+        if (submit(IORING_OP_READV, req, fd, offset))
+            return;
+        guard.unlock(); // 提交失败，就地同步读
+        finish(req, preadFull(fd, buf, len, offset));
+        return;
+    }
+    guard.unlock();
+    pool->enqueue([this, req, fd, offset] {
+        finish(req, preadFull(fd, static_cast<char *>(req->iov.iov_base), req->iov.iov_len, offset));
+    });
+}
+
+bool ioqueue::submit(uint8_t opcode, request *req, int fd, uint64_t offset) {
+    unsigned tail     = *sqTail; // 只有持有 lock 的线程写 tail
+    unsigned idx      = tail & *sqMask;
+    io_uring_sqe *sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->off       = offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(req);
+    if (req) {
+        sqe->addr = reinterpret_cast<uint64_t>(&req->iov);
+        sqe->len  = 1;
+    }
+    sqArray[idx] = idx;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+        int ret = uringEnter(ringFd, 1, 0, 0);
+        if (ret >= 1)
+            return true;
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            break;
+        std::this_thread::yield(); // 内核暂时没有资源，稍后重试
+    }
+    std::cerr << "Error: io_uring_enter failed: " << strerror(errno) << std::endl;
+    if (__atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == tail) { // 内核还没有取走，撤回
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+void ioqueue::reapLoop() {
+    std::vector<std::pair<request *, ssize_t>> done;
+    for (;;) {
+        if (uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            std::cerr << "Error: io_uring_enter failed: " << strerror(errno) << std::endl;
+            std::this_thread::yield();
+        }
+        bool stop = false;
+        {
+            // 请求是提交者在持锁时写进队列的，这里也持锁读，不依赖内核在两边建立的内存顺序（TSAN 看不到）
+            std::lock_guard<std::mutex> guard(lock);
+            unsigned head = *cqHead; // 只有本线程写 head
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe &cqe = cqes[head & *cqMask];
+                if (!cqe.user_data)
+                    stop = true;
+                else
+                    done.emplace_back(reinterpret_cast<request *>(cqe.user_data), cqe.res);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE); // 先归还完成队列的位置，再执行回调
+        }
+        for (auto &d : done)
+            finish(d.first, d.second);
+        done.clear();
+        if (stop)
+            return;
+    }
+}
+
+void ioqueue::finish(request *req, ssize_t res) {
+    inCallback = true;
+    req->cb(res);
+    inCallback = false;
+    delete req;
+    std::lock_guard<std::mutex> guard(lock);
+    inflight--; // 回调返回之后才减，析构时等到 0 就不会再有回调在执行
+    slotCond.notify_all();
+}
@@ -0,0 +1,78 @@
+#ifndef LSM_KV_IOQUEUE_H
+#define LSM_KV_IOQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <thread>
+
+class ThreadPool;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * 异步读文件。优先使用 io_uring（直接走系统调用，不依赖 liburing），
+ * 内核不支持、被禁用或 useUring 为 false 时退回线程池中的 pread。
+ * 完成回调在后台线程中执行，回调中可以继续提交读请求。
+ * 线程安全；析构时等待所有已提交的请求完成。
+ */
+class ioqueue {
+public:
+    using callback = std::function<void(ssize_t)>; // 参数为读到的字节数，出错时为 -errno
+
+    ioqueue(unsigned depth, bool useUring);
+    ~ioqueue();
+
+    ioqueue(const ioqueue &) = delete;
+    ioqueue &operator=(const ioqueue &) = delete;
+
+    // buf 在回调之前必须一直有效
+    void read(int fd, char *buf, size_t len, uint64_t offset, callback cb);
+
+    bool usingUring() const {
+        return ringFd >= 0;
+    }
+
+private:
+    struct request {
+        struct iovec iov;
+        callback cb;
+    };
+
+    unsigned depth;
+    int ringFd = -1;
+    // 提交队列
+    void *sqRing       = nullptr;
+    size_t sqRingSize  = 0;
+    unsigned *sqHead   = nullptr;
+    unsigned *sqTail   = nullptr;
+    unsigned *sqMask   = nullptr;
+    unsigned *sqArray  = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize    = 0;
+    // 完成队列，与提交队列共用一次映射时 cqRing == sqRing
+    void *cqRing       = nullptr;
+    size_t cqRingSize  = 0;
+    unsigned *cqHead   = nullptr;
+    unsigned *cqTail   = nullptr;
+    unsigned *cqMask   = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    std::mutex lock;
+    std::condition_variable slotCond; // 有请求完成
+    unsigned inflight = 0;
+    std::thread reaper;               // io_uring 的完成线程
+    std::unique_ptr<ThreadPool> pool; // 退回时使用
+
+    bool setupRing();
+    bool submit(uint8_t opcode, request *req, int fd, uint64_t offset); // 调用者持有 lock，失败时返回 false
+    void reapLoop();
+    void finish(request *req, ssize_t res);
+};
+
+#endif // LSM_KV_IOQUEUE_H
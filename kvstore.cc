@@ -1,43 +1,67 @@
 #include "kvstore.h"
 
+#include "crc32c.h"
 #include "embedding.h"
 #include "skiplist.h"
 #include "sstable.h"
+#include "tablebuilder.h"
+#include "tableiter.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <queue>
 #include <set>
 #include <string>
 #include <utility>
+#include <sys/uio.h>
+#include <unistd.h>
 using namespace std::chrono;
 
 static const std::string DEL = "~DELETED~";
-const uint32_t MAXSIZE       = 2 * 1024 * 1024;
+const size_t MAX_IMMUTABLE   = 4;           // imm 超过这个数量时写者才会阻塞
+const size_t MAX_GROUP       = 1024 * 1024; // 一次组提交最多合并的日志字节数
+const unsigned IO_DEPTH      = 64;          // getAsync 同时在途的读请求数
 
 struct poi {
     int sstableId; // vector中第几个sstable
-    int pos;       // 该sstable的第几个key-offset
-    uint64_t time;
-    Index index;
+    uint64_t time; // 同一个 key 取 time 最大的，见 tableRank
+    uint64_t key;  // 该sstable迭代器当前的key
 };
 
 struct cmpPoi {
     bool operator()(const poi &a, const poi &b) {
-        if (a.index.key == b.index.key)
+        if (a.key == b.key)
             return a.time < b.time;
-        return a.index.key > b.index.key;
+        return a.key > b.key;
     }
 };
 
-KVStore::KVStore(const std::string &dir) :
-    KVStoreAPI(dir) // read from sstables
-{
+/*
+ * 多个 sstable 中有同一个 key 时新数据的优先级。
+ * compaction 输出的 sstable 会拿到新的时间戳，所以时间戳只能用来比较 level-0 内部的新旧；
+ * 跨层时层数小的更新，level-1 及以下每层内部 key 不重叠。
+ */
+static uint64_t tableRank(int level, int totalLevel, uint64_t time) {
+    if (level == 0)
+        return totalLevel + 1 + time;
+    return totalLevel + 1 - level;
+}
+
+KVStore::KVStore(const std::string &dir, const Options &options) :
+    KVStoreAPI(dir), // read from sstables
+    options(options),
+    walDir(dir + "/wal/"),
+    tables(options.maxOpenFiles, options.mmapReads),
+    blockCache(options.mmapReads ? 0 : options.blockCacheSize) {
+    s = newMemtable(options.memtable);
     for (totalLevel = 0;; ++totalLevel) {
         std::string path = dir + "/level-" + std::to_string(totalLevel) + "/";
         std::vector<std::string> files;
@@ -49,24 +73,92 @@ KVStore::KVStore(const std::string &dir) :
         sstablehead cur;
         for (int i = 0; i < nums; ++i) {       // 读每一个文件头
             std::string url = path + files[i]; // url, 每一个文件名
-            cur.loadFileHead(url.data());
+            if (url.size() < 4 || url.substr(url.size() - 4) != ".sst") {
+                utils::rmfile(url.data()); // 崩溃时没有写完的临时文件
+                continue;
+            }
+            if (!cur.loadFileHead(url.data())) {
+                std::cerr << "Error: Corrupted sstable " << url << ", skipped" << std::endl;
+                continue;
+            }
             sstableIndex[totalLevel].push_back(cur);
             TIME = std::max(TIME, cur.getTime()); // 更新时间戳
         }
+        arrangeLevel(totalLevel); // 目录中的顺序是任意的
     }
+    recover();
+    flusher = std::thread(&KVStore::flushLoop, this);
+}
+
+std::string KVStore::logName(uint64_t number) {
+    return walDir + std::to_string(number) + ".log";
+}
+
+/*
+ * 按编号从小到大重放上次没有落盘的日志。重放出的数据超过一个 memtable 时直接写成 level-0，
+ * 剩下的部分留在 memtable 中，并作为一条记录写入新的日志，之后删除旧日志。
+ */
+void KVStore::recover() {
+    if (!utils::dirExists(walDir))
+        utils::mkdir(walDir.c_str());
+    std::vector<std::string> files;
+    std::vector<uint64_t> numbers;
+    utils::scanDir(walDir, files);
+    for (const auto &file : files) {
+        if (file.size() > 4 && file.substr(file.size() - 4) == ".log")
+            numbers.push_back(std::stoull(file));
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint64_t number : numbers) {
+        wal::replay(logName(number), [this](uint8_t type, uint64_t key, std::string &&val) {
+            if (type == WAL_DEL)
+                val = DEL;
+            if (s->getBytes() && s->getBytes() + 12 + val.length() + 10240 + 32 > options.tableSize) {
+                if (flushMemtable(s)) // 失败时留在 memtable 中，最后写进新的日志
+                    s->reset();
+            }
+            s->upsert(key, val);
+        });
+    }
+
+    logNumber = numbers.empty() ? 0 : numbers.back();
+    log.open(logName(++logNumber));
+    if (s->getBytes()) {
+        std::string entries;
+        uint32_t count = 0;
+        for (auto cur = s->begin(); cur->valid(); cur->next(), ++count)
+            wal::appendEntry(entries, WAL_PUT, cur->key(), cur->value());
+        log.append(wal::makeRecord(entries, count), true);
+    }
+    for (uint64_t number : numbers)
+        utils::rmfile(logName(number).c_str());
 }
 
 KVStore::~KVStore() {
+    {
+        std::lock_guard<std::mutex> lock(memLock);
+        stopFlush = true;
+    }
+    flushCond.notify_all();
+    flusher.join(); // flusher 会先把剩下的 imm 全部写完
+
     sstable ss(s);
-    if (!ss.getCnt())
-        return; // empty sstable
-    std::string path = std::string("./data/level-0/");
-    if (!utils::dirExists(path)) {
-        utils::_mkdir(path.data());
-        totalLevel = 0;
-    }
-    ss.putFile(ss.getFilename().data());
-    compaction();   // 从0层开始尝试合并
+    bool flushed = true;
+    if (ss.getCnt()) {
+        std::string path = std::string("./data/level-0/");
+        if (!utils::dirExists(path)) {
+            utils::_mkdir(path.data());
+            totalLevel = 0;
+        }
+        flushed = ss.putFile(ss.getFilename().data(), options.syncTables, options.compression);
+        if (flushed)
+            compaction(); // 从0层开始尝试合并
+    }
+    log.close();
+    if (flushed) // memtable 已经落盘，日志不再需要；否则留给下次打开时恢复
+        utils::rmfile(logName(logNumber).c_str());
+    delete s;
     /*merge_vector(); // merge all
 
     collectIntoFiles("embedding_data");
@@ -78,92 +170,733 @@ KVStore::~KVStore() {
  * No return values for simplicity.
  */
 void KVStore::put(uint64_t key, const std::string &val) {
-    uint32_t nxtsize = s->getBytes();
-    std::string res  = s->search(key);
-    if (!res.length()) { // new add
-        nxtsize += 12 + val.length();
-    } else
-        nxtsize = nxtsize - res.length() + val.length(); // change string
-
-    if (nxtsize + 10240 + 32 <= MAXSIZE) {
-        s->insert(key, val); // 小于等于（不超过） 2MB
-        tmp_vec.push_back(val);
-        tmp_key.push_back(key);
-    } else {
-        tmp_vec.push_back(val);
-        tmp_key.push_back(key);
+    writer w;
+    wal::appendEntry(w.entries, WAL_PUT, key, val);
+    w.count = 1;
+    commit(w);
+}
 
-        //merge_vector();
+void KVStore::write(const WriteBatch &batch) {
+    if (!batch.count())
+        return;
+    writer w;
+    w.entries = batch.rep;
+    w.count   = batch.count();
+    commit(w);
+}
 
-        sstable ss(s);
-        s->reset();
-        std::string url  = ss.getFilename();
-        std::string path = "./data/level-0";
-        if (!utils::dirExists(path)) {
-            utils::mkdir(path.data());
-            totalLevel = 0;
+/*
+ * 组提交：写请求先排队，队首的写请求把当前排队的请求合成一条日志记录，
+ * 写日志（以及 fdatasync）时不持有 memLock，写完后统一插入 memtable 并唤醒其它请求。
+ * memtable 是 concurrent() 的实现时（MEMTABLE_CONCURRENT），队首只给每个请求分配序号，
+ * 各个写者醒来后在 memLock 之外同时插入自己的条目，下一组可以接着写日志。
+ */
+bool KVStore::commit(writer &w) {
+    std::unique_lock<std::mutex> lock(memLock);
+    writers.push_back(&w);
+    w.cond.wait(lock, [&] { return w.done || writers.front() == &w; });
+    if (w.done) { // 已经由其它写请求代为提交
+        if (w.mem) {
+            lock.unlock();
+            insertEntries(w);
         }
-        addsstable(ss, 0);      // 加入缓存
-        ss.putFile(url.data()); // 加入磁盘
-        compaction();
-        s->insert(key, val);
+        return w.rotated;
+    }
+
+    std::string entries;
+    uint32_t count = 0;
+    writer *last   = &w;
+    for (writer *x : writers) {
+        if (x != &w && (!x->count || entries.size() + x->entries.size() > MAX_GROUP))
+            break;
+        entries += x->entries;
+        count += x->count;
+        last = x;
+    }
+    bool rotated = makeRoom(entries, count, lock);
+
+    lock.unlock();
+    if (!log.append(wal::makeRecord(entries, count), options.sync))
+        std::cerr << "Error: write-ahead log failed, recent writes may not survive a crash" << std::endl;
+    lock.lock();
+
+    while (true) {
+        writer *x = writers.front();
+        writers.pop_front();
+        applyEntries(x->entries, x->embed);
+        if (s->concurrent()) {
+            x->mem = s;
+            x->seq = memSeq;
+            memSeq += x->count;
+            s->writers++;
+            s->pendingBytes += x->entries.size() + x->count * DEL.length(); // 与 makeRoom 中的上界相同
+        }
+        x->rotated = rotated;
+        if (x != &w) {
+            x->done = true;
+            x->cond.notify_one();
+        }
+        if (x == last)
+            break;
+    }
+    if (!writers.empty())
+        writers.front()->cond.notify_one();
+    if (w.mem) {
+        lock.unlock();
+        insertEntries(w);
+    }
+    return rotated;
+}
+
+/*
+ * 写入 entries 会让 memtable 落盘后超过 options.tableSize 时，把当前 memtable 连同它的日志挂到 imm 队列上
+ * 交给后台 flusher，换一个新的 memtable 和日志；只有 imm 堆积超过 MAX_IMMUTABLE 时才等待。
+ * 返回是否切换了 memtable。
+ */
+bool KVStore::makeRoom(const std::string &entries, uint32_t count, std::unique_lock<std::mutex> &lock) {
+    // 还没插完的并发写入按上界计入，它们插完之前可能被重复计算，只会早一点切换
+    uint64_t bytes = s->getBytes() + s->pendingBytes;
+    if (!bytes)
+        return false;
+    // 每个条目在日志中占 13 + value 长度，墓碑的 value 最多 DEL.length()，
+    // 所以这是写入后大小的上界，离 tableSize 还远时不必逐个查找 memtable
+    if (bytes + entries.size() + count * DEL.length() + 10240 + 32 <= options.tableSize)
+        return false;
+
+    uint64_t nxtsize = bytes;
+    wal::decodeEntries(entries.data(), entries.size(), [&](uint8_t type, uint64_t key, std::string &&val) {
+        uint32_t len = type == WAL_DEL ? DEL.length() : val.length();
+        const char *old;
+        uint32_t oldLen;
+        if (s->find(key, old, oldLen))
+            nxtsize = nxtsize - oldLen + len; // change string
+        else
+            nxtsize += 12 + len; // new add
+    });
+    if (nxtsize + 10240 + 32 <= options.tableSize)
+        return false; // 小于等于（不超过） tableSize
+
+    immCond.wait(lock, [this] { return imm.size() < MAX_IMMUTABLE; });
+    imm.push_back(s);
+    immLogs.push_back(logNumber);
+    s = newMemtable(options.memtable);
+    log.open(logName(++logNumber));
+    flushCond.notify_one();
+    return true;
+}
+
+// concurrent() 的 memtable 在这里只收集 embed，条目由写者在 insertEntries 中插入
+void KVStore::applyEntries(const std::string &entries, bool embed) {
+    bool insert = !s->concurrent();
+    if (!insert && !embed)
+        return;
+    wal::decodeEntries(entries.data(), entries.size(), [&](uint8_t type, uint64_t key, std::string &&val) {
+        if (type == WAL_DEL)
+            val = DEL;
+        if (insert)
+            s->upsert(key, val);
+        if (embed) {
+            tmp_vec.push_back(std::move(val));
+            tmp_key.push_back(key);
+        }
+    });
+}
+
+void KVStore::insertEntries(writer &w) {
+    uint64_t seq = w.seq;
+    wal::decodeEntries(w.entries.data(), w.entries.size(), [&](uint8_t type, uint64_t key, std::string &&val) {
+        w.mem->upsertOrdered(key, type == WAL_DEL ? DEL : val, seq++);
+    });
+    w.mem->pendingBytes -= w.entries.size() + w.count * DEL.length();
+    w.mem->writers.fetch_sub(1, std::memory_order_release); // flusher 看到归零时也能看到插入的条目
+}
+
+void KVStore::flushLoop() {
+    while (true) {
+        memtable *mem;
+        uint64_t number;
+        {
+            std::unique_lock<std::mutex> lock(memLock);
+            flushCond.wait(lock, [this] { return stopFlush || !imm.empty(); });
+            if (imm.empty())
+                return; // stopFlush 且已经全部落盘
+            mem    = imm.front();
+            number = immLogs.front();
+        }
+        while (mem->writers.load(std::memory_order_acquire)) // 切换之前提交的并发写入还没插完
+            std::this_thread::yield();
+        if (!flushMemtable(mem)) {
+            // 写 sstable 失败（磁盘满等），imm 和它的日志都留着，过一会儿再试；
+            // 关闭时仍然失败就放弃，下次打开时从日志恢复
+            std::unique_lock<std::mutex> lock(memLock);
+            if (flushCond.wait_for(lock, std::chrono::seconds(1), [this] { return stopFlush; }))
+                return;
+            continue;
+        }
+        {
+            // sstable 已经可见之后才把 imm 移出，读者不会错过这部分数据
+            std::lock_guard<std::mutex> lock(memLock);
+            imm.pop_front();
+            immLogs.pop_front();
+        }
+        utils::rmfile(logName(number).c_str()); // 数据已经在 level-0 中
+        delete mem;
+        immCond.notify_all();
     }
 }
 
+bool KVStore::flushMemtable(memtable *mem) {
+    sstable ss(mem);
+    std::string url  = ss.getFilename();
+    std::string path = "./data/level-0";
+    if (!utils::dirExists(path))
+        utils::mkdir(path.data());
+    if (!ss.putFile(url.data(), options.syncTables, options.compression)) // 加入磁盘，写完才有块索引
+        return false;
+    levelupdate update = prepareLevel(0, {}, {ss.getHead()}); // 排序、更新摘要都在锁外
+    {
+        std::lock_guard<std::shared_mutex> lock(tableLock); // 只在加入缓存时挡住读者
+        totalLevel = std::max(totalLevel, 0);
+        installLevel(update);
+        stats.flushes++;
+        stats.flushBytes += ss.getBytes();
+        stats.flushMemory += mem->memoryUsage();
+    }
+    compaction();
+    return true;
+}
+
+size_t KVStore::memtableMemory() {
+    std::lock_guard<std::mutex> lock(memLock);
+    size_t res = s->memoryUsage();
+    for (memtable *m : imm)
+        res += m->memoryUsage();
+    return res;
+}
+
+KVStore::Stats KVStore::getStats() {
+    std::shared_lock<std::shared_mutex> lock(tableLock);
+    Stats res       = stats;
+    res.cacheHits   = blockCache.hits();
+    res.cacheMisses = blockCache.misses();
+    res.cacheUsage  = blockCache.usage();
+    res.levelSkips  = levelSkips;
+    res.readErrors  = readErrors;
+    return res;
+}
+
+void KVStore::waitFlushed() {
+    std::unique_lock<std::mutex> lock(memLock);
+    immCond.wait(lock, [this] { return imm.empty(); });
+}
+
 /**
  * Returns the (string) value of the given key.
  * An empty string indicates not found.
  */
 std::string KVStore::get(uint64_t key) //
 {
-    uint64_t time = 0;
-    int goalOffset;
-    uint32_t goalLen;
-    std::string goalUrl;
-    std::string res = s->search(key);
+    std::string res = memtableGet(key);
     if (res.length()) { // 在memtable中找到, 或者是deleted，说明最近被删除过，
                         // 不用查sstable
         if (res == DEL)
             return "";
         return res;
     }
+    valueref val;
+    if (sstableGet(key, val) != READ_FOUND) // 读到损坏的数据时也是空串，见 lookup
+        return "";
+    return val.toString();
+}
+
+bool KVStore::get(uint64_t key, valueref &value) {
+    return lookup(key, value) == READ_FOUND;
+}
+
+READ_STATUS KVStore::lookup(uint64_t key, valueref &value) {
+    std::string res = memtableGet(key);
+    if (res.length()) { // memtable 中的 value 随时可能被覆盖，只能拷贝
+        if (res == DEL) {
+            value.reset();
+            return READ_NOT_FOUND;
+        }
+        value = valueref(std::move(res));
+        return READ_FOUND;
+    }
+    return sstableGet(key, value);
+}
+
+std::string KVStore::memtableGet(uint64_t key) {
+    std::lock_guard<std::mutex> lock(memLock);
+    std::string res = s->search(key);
+    for (auto it = imm.rbegin(); !res.length() && it != imm.rend(); ++it)
+        res = (*it)->search(key); // 从新到旧查找 imm
+    return res;
+}
+
+READ_STATUS KVStore::sstableGet(uint64_t key, valueref &val) {
+    std::shared_lock<std::shared_mutex> lock(tableLock); // 多个 get 可以同时读 sstable
+    uint32_t hash = levelfilter::hash(key);
     for (int level = 0; level <= totalLevel; ++level) {
-        for (sstablehead it : sstableIndex[level]) {
-            if (key < it.getMinV() || key > it.getMaxV())
+        if (!levelMayContain(level, key, hash))
+            continue;
+        READ_STATUS res = levelGet(level, key, val);
+        if (res == READ_NOT_FOUND)
+            continue;
+        if (res == READ_FOUND && val.view() != DEL)
+            return READ_FOUND;
+        // 删除标记：层数小的更新，找到就不用再往下查；损坏的块：不知道这一层的值，也不能往下查
+        val.reset();
+        if (res == READ_CORRUPTED)
+            readErrors++;
+        return res == READ_CORRUPTED ? READ_CORRUPTED : READ_NOT_FOUND;
+    }
+    val.reset();
+    return READ_NOT_FOUND;
+}
+
+READ_STATUS KVStore::levelGet(int level, uint64_t key, valueref &val) {
+    const std::vector<sstablehead> &tables = sstableIndex[level];
+    if (level == 0) { // key 范围互相重叠，按时间戳从新到旧查，第一次找到的（或损坏的）就是结果
+        for (auto it = tables.rbegin(); it != tables.rend(); ++it) {
+            if (key < it->getMinV() || key > it->getMaxV())
                 continue;
-            uint32_t len;
-            int offset = it.searchOffset(key, len);
-            if (offset == -1) {
-                if (!level)
+            READ_STATUS res = tableGet(*it, key, val);
+            if (res != READ_NOT_FOUND)
+                return res;
+        }
+        return READ_NOT_FOUND;
+    }
+    if (levelOverlap[level]) { // 崩溃残留的重叠，只能逐个查，取时间戳最新的
+        uint64_t time = 0, corrupted = 0; // 找到的和损坏的 sstable 中最新的时间戳
+        for (const sstablehead &it : tables) {
+            valueref cur;
+            if (key < it.getMinV() || key > it.getMaxV() || it.getTime() <= std::max(time, corrupted))
+                continue;
+            READ_STATUS res = tableGet(it, key, cur);
+            if (res == READ_CORRUPTED)
+                corrupted = it.getTime();
+            if (res != READ_FOUND)
+                continue;
+            time = it.getTime();
+            val  = std::move(cur);
+        }
+        if (corrupted > time)
+            return READ_CORRUPTED;
+        return time != 0 ? READ_FOUND : READ_NOT_FOUND;
+    }
+    // 层内按 key 排列且互不重叠，二分找到唯一可能含有 key 的 sstable
+    auto it = std::lower_bound(tables.begin(), tables.end(), key, [](const sstablehead &t, uint64_t k) {
+        return t.getMaxV() < k;
+    });
+    if (it == tables.end() || key < it->getMinV())
+        return READ_NOT_FOUND;
+    return tableGet(*it, key, val);
+}
+
+/*
+ * 先把 key 排序，持一次 memLock 查完所有 memtable；剩下的 key 逐层往下查：
+ * level-0 按 sstable 从新到旧，每个 sstable 一批；其余各层用双指针把 key 分给唯一可能的 sstable。
+ * 每个 sstable 的块一起读，见 readBlocks。
+ */
+std::vector<std::string> KVStore::multiGet(const std::vector<uint64_t> &keys) {
+    std::vector<READ_STATUS> status;
+    return multiGet(keys, status);
+}
+
+std::vector<std::string> KVStore::multiGet(const std::vector<uint64_t> &keys, std::vector<READ_STATUS> &status) {
+    std::vector<std::string> res(keys.size());
+    status.assign(keys.size(), READ_NOT_FOUND);
+    std::vector<int> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+    std::vector<int> pending; // 还没找到的下标，按 key 递增
+    {
+        std::lock_guard<std::mutex> lock(memLock);
+        for (int i : order) {
+            std::string val = s->search(keys[i]);
+            for (auto it = imm.rbegin(); !val.length() && it != imm.rend(); ++it)
+                val = (*it)->search(keys[i]); // 从新到旧查找 imm
+            if (!val.length()) {
+                pending.push_back(i);
+            } else if (val != DEL) {
+                res[i]    = std::move(val);
+                status[i] = READ_FOUND;
+            }
+        }
+    }
+
+    std::vector<uint32_t> hashes(keys.size());
+    for (int i : pending)
+        hashes[i] = levelfilter::hash(keys[i]);
+
+    std::shared_lock<std::shared_mutex> lock(tableLock);
+    std::vector<int> missed, group, skipped;
+    for (int level = 0; level <= totalLevel && !pending.empty(); ++level) {
+        const std::vector<sstablehead> &tables = sstableIndex[level];
+        skipped.clear(); // 被这一层的摘要排除的，不用查，留到下一层
+        for (int i : pending)
+            (levelMayContain(level, keys[i], hashes[i]) ? missed : skipped).push_back(i);
+        pending.swap(missed);
+        missed.clear();
+
+        if (level == 0) {
+            for (auto it = tables.rbegin(); it != tables.rend() && !pending.empty(); ++it) {
+                tableMultiGet(*it, keys, pending, res, status, missed);
+                pending.swap(missed);
+                missed.clear();
+            }
+        } else if (levelOverlap[level]) { // 少见，逐个查
+            for (int i : pending) {
+                valueref val;
+                READ_STATUS st = levelGet(level, keys[i], val);
+                if (st == READ_NOT_FOUND) {
+                    missed.push_back(i);
+                } else if (st == READ_CORRUPTED) {
+                    status[i] = READ_CORRUPTED;
+                } else if (val.view() != DEL) {
+                    res[i]    = val.toString();
+                    status[i] = READ_FOUND;
+                }
+            }
+            pending.swap(missed);
+            missed.clear();
+        } else {
+            size_t t = 0;
+            for (size_t i = 0; i < pending.size();) {
+                uint64_t key = keys[pending[i]];
+                while (t < tables.size() && tables[t].getMaxV() < key)
+                    t++;
+                if (t == tables.size() || key < tables[t].getMinV()) {
+                    missed.push_back(pending[i++]); // 不在这一层任何 sstable 的范围内
                     continue;
-                else
-                    break;
+                }
+                group.clear();
+                for (; i < pending.size() && keys[pending[i]] <= tables[t].getMaxV(); ++i)
+                    group.push_back(pending[i]);
+                tableMultiGet(tables[t], keys, group, res, status, missed);
             }
-            // sstable ss;
-            // ss.loadFile(it.getFilename().data());
-            if (it.getTime() > time) { // find the latest head
-                time       = it.getTime();
-                goalUrl    = it.getFilename();
-                goalOffset = offset + 32 + 10240 + 12 * it.getCnt();
-                goalLen    = len;
+            pending.swap(missed);
+            missed.clear();
+        }
+
+        if (!skipped.empty()) { // 并回去，pending 仍然按 key 递增
+            missed.resize(pending.size() + skipped.size());
+            std::merge(pending.begin(), pending.end(), skipped.begin(), skipped.end(), missed.begin(),
+                       [&keys](int a, int b) { return keys[a] < keys[b]; });
+            pending.swap(missed);
+            missed.clear();
+        }
+    }
+    readErrors += std::count(status.begin(), status.end(), READ_CORRUPTED);
+    return res;
+}
+
+void KVStore::tableMultiGet(
+    const sstablehead &table,
+    const std::vector<uint64_t> &keys,
+    const std::vector<int> &idx,
+    std::vector<std::string> &res,
+    std::vector<READ_STATUS> &status,
+    std::vector<int> &missed
+) {
+    if (table.getFormat() != TABLE_BLOCK) {
+        for (int i : idx) {
+            uint64_t key = keys[i];
+            valueref val;
+            if (key < table.getMinV() || key > table.getMaxV() || tableGet(table, key, val) != READ_FOUND) {
+                missed.push_back(i);
+            } else if (val.view() != DEL) {
+                res[i]    = val.toString();
+                status[i] = READ_FOUND;
             }
         }
-        if (time)
-            break; // only a test for found
+        return;
     }
-    if (!goalUrl.length())
-        return ""; // not found a sstable
-    res = fetchString(goalUrl, goalOffset, goalLen);
-    if (res == DEL)
-        return "";
+    std::vector<int> blockOf(idx.size(), -1), ids; // 每个 key 所在的块，以及要读的块（递增、不重复）
+    for (size_t j = 0; j < idx.size(); ++j) {
+        uint64_t key = keys[idx[j]];
+        if (key < table.getMinV() || key > table.getMaxV())
+            continue;
+        int p = table.findBlock(key);
+        if (p == -1)
+            continue;
+        if (ids.empty() || ids.back() != p)
+            ids.push_back(p);
+        blockOf[j] = ids.size() - 1;
+    }
+    std::vector<std::shared_ptr<const std::string>> blocks = readBlocks(table, ids);
+    for (size_t j = 0; j < idx.size(); ++j) {
+        if (blockOf[j] == -1) {
+            missed.push_back(idx[j]);
+            continue;
+        }
+        blockiter it(blocks[blockOf[j]]);
+        it.seek(keys[idx[j]]);
+        if (it.corrupted()) { // 不放进 missed，不再查更旧的层
+            status[idx[j]] = READ_CORRUPTED;
+            continue;
+        }
+        if (!it.valid() || it.key() != keys[idx[j]]) {
+            missed.push_back(idx[j]);
+            continue;
+        }
+        if (it.valueLen() != DEL.length() || it.value() != DEL) {
+            res[idx[j]]    = it.value();
+            status[idx[j]] = READ_FOUND;
+        }
+    }
+}
+
+READ_STATUS KVStore::tableGet(const sstablehead &table, uint64_t key, valueref &val) {
+    if (table.getFormat() != TABLE_BLOCK) {
+        uint32_t len;
+        int offset = table.searchOffset(key, len);
+        if (offset == -1)
+            return READ_NOT_FOUND;
+        val = fetchRef(table.getFilename(), offset + 32 + 10240 + 12 * table.getCnt(), len);
+        return READ_FOUND;
+    }
+    int p = table.findBlock(key); // 只读可能含有 key 的那一个块
+    if (p == -1)
+        return READ_NOT_FOUND;
+    blockiter it = openBlock(table, p);
+    it.seek(key);
+    if (it.corrupted())
+        return READ_CORRUPTED;
+    if (!it.valid() || it.key() != key)
+        return READ_NOT_FOUND;
+    val = it.valueRef();
+    return READ_FOUND;
+}
+
+/*
+ * getAsync 的状态。候选是按新旧顺序排列的、可能含有 key 的数据块（老格式的 sstable 直接是 value 所在的范围），
+ * 在 tableLock 下一次选好，之后不再持锁；每个候选持有文件句柄，所在的 sstable 被 compaction 删除后仍然可以读。
+ */
+struct KVStore::asyncGet {
+    struct candidate {
+        std::shared_ptr<tablehandle> handle;
+        std::string file;
+        uint64_t offset;
+        uint32_t size;
+        bool block;      // false 时为老格式 sstable 中的 value
+        bool verify;     // 读到之后按 crc 校验
+        bool compressed; // 读到之后要解压
+        uint32_t crc = 0;
+
+        // 校验并解压读到的数据，失败时报错并返回 false
+        bool decode(std::string &data) const {
+            if (verify && crc32c::value(data.data(), data.size()) != crc) {
+                std::cerr << "Error: Checksum mismatch in block at offset " << offset << " of file " << file
+                          << std::endl;
+                return false;
+            }
+            if (compressed && !uncompressBlock(data)) {
+                std::cerr << "Error: Corrupted block at offset " << offset << " of file " << file << std::endl;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    uint64_t key;
+    std::function<void(READ_STATUS, std::string)> callback;
+    std::vector<candidate> cands;
+    size_t pos = 0;
+    std::string buf; // 正在异步读的数据
+
+    // 在当前候选的数据中查 key：找到时回调并返回 READ_FOUND；没有时移到下一个候选，返回 READ_NOT_FOUND；
+    // 块损坏时返回 READ_CORRUPTED，由调用者报错，不再查后面的候选
+    READ_STATUS match(const std::shared_ptr<const std::string> &data) {
+        std::string val;
+        if (cands[pos].block) {
+            blockiter it(data);
+            it.seek(key);
+            if (it.corrupted())
+                return READ_CORRUPTED;
+            if (!it.valid() || it.key() != key) {
+                pos++;
+                return READ_NOT_FOUND;
+            }
+            val = it.value();
+        } else {
+            val = *data;
+        }
+        if (val == DEL)
+            callback(READ_NOT_FOUND, "");
+        else
+            callback(READ_FOUND, std::move(val));
+        return READ_FOUND;
+    }
+};
+
+void KVStore::getAsync(uint64_t key, std::function<void(std::string)> callback) {
+    getAsync(key, [callback = std::move(callback)](READ_STATUS, std::string val) { callback(std::move(val)); });
+}
+
+void KVStore::getAsync(uint64_t key, std::function<void(READ_STATUS, std::string)> callback) {
+    std::string res = memtableGet(key);
+    if (res.length()) {
+        if (res == DEL)
+            callback(READ_NOT_FOUND, "");
+        else
+            callback(READ_FOUND, std::move(res));
+        return;
+    }
+
+    auto g      = std::make_shared<asyncGet>();
+    g->key      = key;
+    g->callback = std::move(callback);
+    auto add    = [&](const sstablehead &t) {
+        if (key < t.getMinV() || key > t.getMaxV())
+            return;
+        asyncGet::candidate c;
+        if (t.getFormat() == TABLE_BLOCK) {
+            int p = t.findBlock(key);
+            if (p == -1)
+                return;
+            BlockIndex b = t.getBlock(p);
+            c.offset     = b.offset;
+            c.size       = b.size;
+            c.block      = true;
+            c.verify     = options.verifyChecksums && t.hasChecksums();
+            c.compressed = t.isCompressed();
+            c.crc        = b.crc;
+        } else {
+            int offset = t.searchOffset(key, c.size);
+            if (offset == -1)
+                return;
+            c.offset     = offset + 32 + 10240 + 12 * t.getCnt();
+            c.block      = false;
+            c.verify     = false;
+            c.compressed = false;
+        }
+        c.file   = t.getFilename();
+        c.handle = tables.get(c.file);
+        if (c.handle)
+            g->cands.push_back(std::move(c));
+    };
+    {
+        std::shared_lock<std::shared_mutex> lock(tableLock); // 与 levelGet 的查找顺序一致
+        uint32_t hash = levelfilter::hash(key);
+        for (int level = 0; level <= totalLevel; ++level) {
+            const std::vector<sstablehead> &tables = sstableIndex[level];
+            if (!levelMayContain(level, key, hash))
+                continue;
+            if (level == 0) {
+                for (auto it = tables.rbegin(); it != tables.rend(); ++it)
+                    add(*it);
+            } else if (levelOverlap[level]) {
+                std::vector<const sstablehead *> overlap;
+                for (const sstablehead &t : tables)
+                    overlap.push_back(&t);
+                std::sort(overlap.begin(), overlap.end(), [](const sstablehead *a, const sstablehead *b) {
+                    return a->getTime() > b->getTime();
+                });
+                for (const sstablehead *t : overlap)
+                    add(*t);
+            } else {
+                auto it = std::lower_bound(tables.begin(), tables.end(), key, [](const sstablehead &t, uint64_t k) {
+                    return t.getMaxV() < k;
+                });
+                if (it != tables.end())
+                    add(*it);
+            }
+        }
+    }
+    continueGet(std::move(g));
+}
+
+std::future<std::string> KVStore::getAsync(uint64_t key) {
+    auto promise                 = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> res = promise->get_future();
+    getAsync(key, [promise](std::string val) { promise->set_value(std::move(val)); });
     return res;
 }
 
+/*
+ * 读不出来、校验或解压失败、格式不对的候选与同步的 get 一样当作错误：回调 READ_CORRUPTED，不再查更旧的候选。
+ */
+void KVStore::continueGet(std::shared_ptr<asyncGet> g) {
+    auto fail = [this, g]() {
+        readErrors++;
+        g->callback(READ_CORRUPTED, "");
+    };
+    while (g->pos < g->cands.size()) {
+        const asyncGet::candidate &c = g->cands[g->pos];
+        std::shared_ptr<const std::string> data;
+        if (c.handle->base) { // mmap 模式：直接从映射中拷出
+            if (c.offset + c.size > c.handle->size) {
+                std::cerr << "Error: Unable to read " << c.size << " bytes from file " << c.file << std::endl;
+                fail();
+                return;
+            }
+            std::string block(c.handle->base + c.offset, c.size);
+            if (!c.decode(block)) {
+                fail();
+                return;
+            }
+            data = std::make_shared<const std::string>(std::move(block));
+        } else if (c.block && blockCache.getCapacity()) {
+            data = blockCache.lookup(c.file, c.offset);
+        }
+        if (data) {
+            READ_STATUS res = g->match(data);
+            if (res == READ_CORRUPTED)
+                fail();
+            if (res != READ_NOT_FOUND)
+                return;
+            continue;
+        }
+
+        std::call_once(ioOnce, [this] { io = std::make_unique<ioqueue>(IO_DEPTH, options.useIoUring); });
+        g->buf.resize(c.size);
+        io->read(c.handle->fd, g->buf.data(), c.size, c.offset, [this, g, fail](ssize_t n) {
+            const asyncGet::candidate &c = g->cands[g->pos];
+            if (n != (ssize_t)c.size) {
+                std::cerr << "Error: Unable to read " << c.size << " bytes from file " << c.file << std::endl;
+                fail();
+                return;
+            }
+            if (!c.decode(g->buf)) {
+                fail();
+                return;
+            }
+            auto data = std::make_shared<const std::string>(std::move(g->buf));
+            if (c.block)
+                blockCache.insert(c.file, c.offset, data);
+            READ_STATUS res = g->match(data);
+            if (res == READ_CORRUPTED)
+                fail();
+            else if (res == READ_NOT_FOUND)
+                continueGet(g);
+        });
+        return; // 读完之后在回调中继续
+    }
+    g->callback(READ_NOT_FOUND, "");
+}
+
 /**
  * Delete the given key-value pair if it exists.
  * Returns false iff the key is not found.
  */
 bool KVStore::del(uint64_t key) {
+    if (options.blindDelete) {
+        {
+            std::lock_guard<std::mutex> lock(memLock);
+            int state = memtableState(key);
+            if (state == 2)
+                return false; // 已经是墓碑
+            // state == 1 时确实存在；state == 0 时不查 sstable，直接写墓碑
+        }
+        writer w;
+        wal::appendEntry(w.entries, WAL_DEL, key, "");
+        w.count = 1;
+        commit(w);
+        return true;
+    }
     std::string res = get(key);
     if (!res.length())
         return false; // not exist
@@ -171,6 +904,26 @@ bool KVStore::del(uint64_t key) {
     return true;
 }
 
+/*
+ * 只在 memtable 和 imm 中查找 key，不拷贝 value。调用者持有 memLock。
+ * 返回 0 表示不在内存中，1 表示存在，2 表示最近一次写入是墓碑。
+ */
+int KVStore::memtableState(uint64_t key) {
+    auto state = [&](memtable *mem) {
+        const char *val;
+        uint32_t len;
+        if (!mem->find(key, val, len))
+            return 0;
+        if (len == DEL.length() && !std::memcmp(val, DEL.data(), DEL.length()))
+            return 2;
+        return 1;
+    };
+    int res = state(s);
+    for (auto it = imm.rbegin(); !res && it != imm.rend(); ++it)
+        res = state(*it);
+    return res;
+}
+
 void KVStore::removeDirectoryRecursive(const std::string &path) {
     std::vector<std::string> entries;
     if (!utils::scanDir(path, entries)) {
@@ -190,7 +943,21 @@ void KVStore::removeDirectoryRecursive(const std::string &path) {
 }
 
 void KVStore::reset() {
-    s->reset(); // 先清空 memtable
+    // 排进写队列：排到队首时没有别的写请求在写日志，也不会再切换 memtable，
+    // 等后台把 imm 写完，再一起删除
+    writer w;
+    std::unique_lock<std::mutex> memGuard(memLock);
+    writers.push_back(&w);
+    w.cond.wait(memGuard, [&] { return writers.front() == &w; });
+    immCond.wait(memGuard, [this] { return imm.empty(); });
+    std::unique_lock<std::shared_mutex> tableGuard(tableLock);
+    // 先清空 memtable：MEMTABLE_CONCURRENT 的写者可能还在 memLock 之外往 s 中插入，
+    // 所以换一个新的，旧的等这些插入完成后再释放，不在原地清空
+    memtable *old = s;
+    s             = newMemtable(options.memtable);
+    log.close();
+    utils::rmfile(logName(logNumber).c_str());
+    log.open(logName(++logNumber));
     bufferMap.clear();
     vectorMap.clear();
     tmp_vec.clear();
@@ -211,7 +978,11 @@ void KVStore::reset() {
         }
         utils::rmdir(path.c_str());
         sstableIndex[level].clear();
+        levelOverlap[level] = false;
+        summary[level]      = levelsummary();
     }
+    tables.clear();
+    blockCache.clear();
 
     // 删除 vectors 目录及其中的所有文件
     std::string vecDir = "./embedding_data/vectors";
@@ -232,6 +1003,14 @@ void KVStore::reset() {
     }
 
     totalLevel = -1;
+    tableGuard.unlock();
+    writers.pop_front();
+    if (!writers.empty())
+        writers.front()->cond.notify_one();
+    memGuard.unlock(); // 还没插完的写者可能在等 memLock 醒来
+    while (old->writers.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    delete old;
 }
 
 /**
@@ -242,16 +1021,13 @@ void KVStore::reset() {
 
 struct myPair {
     uint64_t key, time;
-    int id, index;
-    std::string filename;
+    int id, index; // id 为 sstable 迭代器的下标，-1 表示 memtable；index 为 memtable 结果的下标
 
-    myPair(uint64_t key, uint64_t time, int index, int id,
-           std::string file) { // construct function
-        this->time     = time;
-        this->key      = key;
-        this->id       = id;
-        this->index    = index;
-        this->filename = file;
+    myPair(uint64_t key, uint64_t time, int index, int id) { // construct function
+        this->time  = time;
+        this->key   = key;
+        this->id    = id;
+        this->index = index;
     }
 };
 
@@ -264,31 +1040,67 @@ struct cmp {
 };
 
 void KVStore::scan(uint64_t key1, uint64_t key2, std::list<std::pair<uint64_t, std::string>> &list) {
-    std::vector<std::pair<uint64_t, std::string>> mem;
+    scan(key1, key2, [&list](uint64_t key, const valueref &val) {
+        list.emplace_back(key, val.toString());
+        return true;
+    });
+}
+
+void KVStore::scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, valueref>> &out) {
+    scan(key1, key2, [&out](uint64_t key, const valueref &val) {
+        out.emplace_back(key, val);
+        return true;
+    });
+}
+
+void KVStore::scan(uint64_t key1, uint64_t key2, const std::function<bool(uint64_t, const valueref &)> &callback) {
+    // memtable 中的结果拷贝出来，所有 value 共用这一份，引用它们的 valueref 一起持有
+    auto mem = std::make_shared<std::vector<std::pair<uint64_t, std::string>>>();
     // std::set<myPair> heap; // 维护一个指针最小堆
     std::priority_queue<myPair, std::vector<myPair>, cmp> heap;
-    // std::vector<sstable> ssts;
-    std::vector<sstablehead> sshs;
-    s->scan(key1, key2, mem);   // add in mem
-    std::vector<int> head, end; // [head, end)
-    int cnt = 0;
-    if (mem.size())
-        heap.push(myPair(mem[0].first, INF, 0, -1, "qwq"));
+    std::vector<tableiter> iters; // 指向 sstableIndex 中的表头，读期间一直持有 tableLock
+    {
+        // 从旧到新合并所有 memtable，新的覆盖旧的
+        std::lock_guard<std::mutex> lock(memLock);
+        if (imm.empty()) {
+            s->scan(key1, key2, *mem); // add in mem
+        } else {
+            std::map<uint64_t, std::string> merged;
+            std::vector<std::pair<uint64_t, std::string>> part;
+            for (memtable *m : imm) {
+                m->scan(key1, key2, part);
+                for (auto &p : part)
+                    merged[p.first] = std::move(p.second);
+                part.clear();
+            }
+            s->scan(key1, key2, part);
+            for (auto &p : part)
+                merged[p.first] = std::move(p.second);
+            mem->assign(merged.begin(), merged.end());
+        }
+    }
+    // 读到损坏的块时停下：跳过它会漏掉这一块中的 key，或者让更旧的层中的值冒出来
+    auto corrupted = [this](const tableiter &iter) {
+        if (!iter.corrupted())
+            return false;
+        std::cerr << "Error: Scan stopped at a corrupted block in " << iter.table().getFilename() << std::endl;
+        readErrors++;
+        return true;
+    };
+    std::shared_lock<std::shared_mutex> lock(tableLock);
+    if (mem->size())
+        heap.push(myPair((*mem)[0].first, INF, 0, -1));
     for (int level = 0; level <= totalLevel; ++level) {
-        for (sstablehead it : sstableIndex[level]) {
+        for (const sstablehead &it : sstableIndex[level]) {
             if (key1 > it.getMaxV() || key2 < it.getMinV())
                 continue; // 无交集
-            int hIndex = it.lowerBound(key1);
-            int tIndex = it.lowerBound(key2);
-            if (hIndex < it.getCnt()) { // 此sstable可用
-                std::string url = it.getFilename();
-                heap.push(myPair(it.getKey(hIndex), it.getTime(), hIndex, cnt++, url));
-                head.push_back(hIndex);
-                if (it.search(key2) == tIndex)
-                    tIndex++; // tIndex为第一个不可的
-                end.push_back(tIndex);
-                // ssts.push_back(ss); // 加入ss
-                sshs.push_back(it);
+            tableiter iter(this, &it);
+            iter.seek(key1);
+            if (corrupted(iter))
+                return;
+            if (iter.valid() && iter.key() <= key2) { // 此sstable可用
+                heap.push(myPair(iter.key(), tableRank(level, totalLevel, it.getTime()), 0, iters.size()));
+                iters.push_back(std::move(iter));
             }
         }
     }
@@ -297,27 +1109,28 @@ void KVStore::scan(uint64_t key1, uint64_t key2, std::list<std::pair<uint64_t, s
         myPair cur = heap.top();
         heap.pop();
         if (cur.id >= 0) { // from sst
+            tableiter &iter = iters[cur.id];
             if (cur.key != lastKey) {
-                lastKey         = cur.key;
-                uint32_t start  = sshs[cur.id].getOffset(cur.index - 1);
-                uint32_t len    = sshs[cur.id].getOffset(cur.index) - start;
-                uint32_t scnt   = sshs[cur.id].getCnt();
-                std::string res = fetchString(cur.filename, 10240 + 32 + scnt * 12 + start, len);
-                if (res.length() && res != DEL)
-                    list.emplace_back(cur.key, res);
+                lastKey      = cur.key;
+                valueref res = iter.valueRef();
+                if (res.size() && res.view() != DEL && !callback(cur.key, res))
+                    return;
             }
-            if (cur.index + 1 < end[cur.id]) { // add next one to heap
-                heap.push(myPair(sshs[cur.id].getKey(cur.index + 1), cur.time, cur.index + 1, cur.id, cur.filename));
+            iter.next();
+            if (corrupted(iter))
+                return;
+            if (iter.valid() && iter.key() <= key2) { // add next one to heap
+                heap.push(myPair(iter.key(), cur.time, 0, cur.id));
             }
         } else { // from mem
             if (cur.key != lastKey) {
-                lastKey         = cur.key;
-                std::string res = mem[cur.index].second;
-                if (res.length() && res != DEL)
-                    list.emplace_back(cur.key, mem[cur.index].second);
+                lastKey                = cur.key;
+                const std::string &res = (*mem)[cur.index].second;
+                if (res.length() && res != DEL && !callback(cur.key, valueref(mem, res.data(), res.size())))
+                    return;
             }
-            if (cur.index < mem.size() - 1) {
-                heap.push(myPair(mem[cur.index + 1].first, cur.time, cur.index + 1, -1, cur.filename));
+            if (cur.index < mem->size() - 1) {
+                heap.push(myPair((*mem)[cur.index + 1].first, cur.time, cur.index + 1, -1));
             }
         }
     }
@@ -349,7 +1162,7 @@ bool KVStore::compaction(int curLevel) {
         return true; // 不需要合并
     }
 
-    // 当前层需要合并
+    // 当前层需要合并。输入先留在原来的层中，合并期间读者照常读，输出写完之后才一起换掉
     std::vector<sstablehead> currentLevelSSTs;
     currentLevelSSTs.clear();
     if (curLevel == 0) {
@@ -357,20 +1170,20 @@ bool KVStore::compaction(int curLevel) {
         for (const auto &item : sstableIndex[0]) {
             currentLevelSSTs.push_back(item);
         }
-        sstableIndex[curLevel].clear(); // 缓存清除
     }
 
     else if (curLevel > 0) {
         // 其他层选择时间戳最小的超出部分
-        // 定义lamda函数
-        sortTable(curLevel);
-        // 直接插入选中的SSTable
-        currentLevelSSTs.insert(
-            currentLevelSSTs.end(), sstableIndex[curLevel].begin(), sstableIndex[curLevel].begin() + excess
-        );
-
-        // 删除选中的部分
-        sstableIndex[curLevel].erase(sstableIndex[curLevel].begin(), sstableIndex[curLevel].begin() + excess);
+        const std::vector<sstablehead> &tables = sstableIndex[curLevel];
+        std::vector<int> order(tables.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&tables](int a, int b) {
+            if (tables[a].getTime() == tables[b].getTime())
+                return tables[a].getMinV() < tables[b].getMinV();
+            return tables[a].getTime() < tables[b].getTime();
+        });
+        for (int i = 0; i < excess; ++i)
+            currentLevelSSTs.push_back(tables[order[i]]);
     }
 
     // 下一层
@@ -409,125 +1222,123 @@ bool KVStore::compaction(int curLevel) {
     }
 
     // 归并排序
-    size_t position = 0;
     std::priority_queue<poi, std::vector<poi>, cmpPoi> mergeQueue;
+    std::vector<tableiter> iters; // 与 allSSTables 一一对应
+    bool ok = true;
+    // 输入中有读不出来或损坏的块时放弃这次合并：跳过它的话，删除输入之后这个块中的 key 就永远丢了
+    auto intact = [curLevel](const tableiter &iter) {
+        if (!iter.corrupted())
+            return true;
+        std::cerr << "Error: Corrupted block in " << iter.table().getFilename() << ", compaction of level-"
+                  << curLevel << " aborted" << std::endl;
+        return false;
+    };
 
-    for (auto &sstable : allSSTables) {
-        if (sstable.getCnt() == 0) {
-            continue; // 跳过空或无效的SSTable
+    for (int position = 0; position < (int)allSSTables.size(); ++position) {
+        auto &sstable = allSSTables[position];
+        iters.emplace_back(this, &sstable);
+        tableiter &iter = iters.back();
+        iter.seekToFirst();
+        if (!iter.valid()) {
+            if (!intact(iter))
+                ok = false;
+            continue; // 跳过空的SSTable
         }
-        if (sstable.getKey(0) == UINT64_MAX) {
+        if (iter.key() == UINT64_MAX) {
             continue;
         }
-        Index tmpIndex{sstable.getKey(0), 0};
-        poi tmp{static_cast<int>(position), 0, sstable.getTime(), tmpIndex};
+        int level = position < (int)currentLevelSSTs.size() ? curLevel : curLevel + 1;
+        poi tmp{position, tableRank(level, totalLevel, sstable.getTime()), iter.key()};
         mergeQueue.push(tmp);
-        position++;
     }
 
-    std::vector<std::pair<uint64_t, std::string>> mergedData; // 存储数据
-    std::string lastValue;
-    uint64_t lastTime = 0;
-    uint64_t lastKey  = UINT64_MAX;
-
-    // 合并数据
-    while (!mergeQueue.empty()) {
-        auto top = mergeQueue.top();
-        mergeQueue.pop();
-        if (top.sstableId > allSSTables.size()) {
+    // 下一层
+    int nextLevel = curLevel + 1;
+    // 目录如果不存在就新建，totalLevel 等换入输出时再更新
+    std::string nextPath = "./data/level-" + std::to_string(nextLevel);
+    if (nextLevel > totalLevel && !utils::dirExists(nextPath))
+        utils::mkdir(nextPath.c_str());
+
+    // 归并的结果逐条交给 tablebuilder 写进下一层，写满 tableSize 就换一个文件，
+    // 内存中只有当前输出的一个块，不再先收集全部结果
+    std::vector<sstablehead> outputs;
+    COMPRESSION_TYPE compression = options.compression;
+    if (compression != COMPRESSION_NONE && nextLevel >= options.coldLevel)
+        compression = COMPRESSION_HIGH; // 冷数据很少再被改写，压得更小
+    std::unique_ptr<tablebuilder> builder;
+    auto finishTable = [&]() {
+        if (!builder->finish())
             return false;
+        outputs.push_back(builder->getHead());
+        builder.reset();
+        return true;
+    };
+    auto emit = [&](uint64_t key, const valueref &value) {
+        if (builder && builder->fileSize() + 12 + value.size() > options.tableSize && !finishTable())
+            return false;
+        if (!builder) {
+            uint64_t time   = ++TIME; // 与原来一样，每个新文件取一个新的时间戳
+            std::string url = "./data/level-" + std::to_string(nextLevel) + "/" + std::to_string(time) + ".sst";
+            builder         = std::make_unique<tablebuilder>(url, time, options.syncTables, compression);
         }
-        auto &sstable = allSSTables[top.sstableId];
-
-        // 如果SSTable为空或位置超出范围，跳过
-        if (sstable.getCnt() == 0) {
-            continue;
-        }
-        if (top.pos >= sstable.getCnt()) {
-            continue;
-        }
-
-        uint64_t key   = sstable.getKey(top.pos);
-        uint64_t time  = sstable.getTime();
-        uint32_t start = 0;
-        if (top.pos != 0) {
-            start = sstable.getOffset(top.pos - 1);
-        }
-        uint32_t len = sstable.getOffset(top.pos) - start;
+        return builder->add(key, value.data(), value.size());
+    };
 
-        // 获取值
-        int StartOffSet = 10240 + 32 + sstable.getCnt() * 12 + start;
-        std::string value;
-        value = fetchString(sstable.getFilename(), StartOffSet, len);
+    valueref lastValue; // 引用输入中的块，不拷贝
+    uint64_t lastKey = UINT64_MAX;
+    // 输出层以下没有更旧的数据时才能丢掉删除标记
+    bool dropDeleted = curLevel + 1 >= totalLevel;
 
-        // 跳过删除标记（对于最后一层）
-        if (value == "~DELETED~" && curLevel == totalLevel) {
-            continue;
-        }
+    // 合并数据
+    while (ok && !mergeQueue.empty()) {
+        auto top = mergeQueue.top();
+        mergeQueue.pop();
+        tableiter &iter = iters[top.sstableId];
 
-        // 如果是新的键或时间戳更新且时间戳更大，则更新记录
-        if (key != lastKey || time > lastTime) {
-            if (lastKey != UINT64_MAX) {
-                std::pair p{lastKey, lastValue};
-                mergedData.emplace_back(p);
-            }
+        uint64_t key = top.key;
+        // 同一个 key 最先出队的是最新的记录，其余的直接跳过
+        if (key != lastKey) {
+            if (lastKey != UINT64_MAX && !(dropDeleted && lastValue.view() == DEL))
+                ok = emit(lastKey, lastValue);
             lastKey   = key;
-            lastValue = value;
-            lastTime  = time;
-        } else if (key == lastKey && time > lastTime) {
-            // 对于相同key的记录，选择时间戳最大的记录
-            lastKey   = key;
-            lastValue = value;
-            lastTime  = time;
+            lastValue = iter.valueRef();
         }
 
         // 处理下一条记录
-        if (top.pos < sstable.getCnt() - 1) {
-            uint64_t nextKey  = sstable.getKey(top.pos + 1);
-            uint64_t nextTime = sstable.getTime();
-            Index nextIndex{nextKey, 0};
-            poi nextIssue{top.sstableId, top.pos + 1, nextTime, nextIndex};
+        iter.next();
+        if (iter.valid()) {
+            poi nextIssue{top.sstableId, top.time, iter.key()};
             mergeQueue.push(nextIssue);
+        } else if (!intact(iter)) {
+            ok = false;
         }
     }
 
-    if (lastKey != UINT64_MAX) {
-        std::pair newPair{lastKey, lastValue};
-        mergedData.push_back(newPair);
+    if (ok && lastKey != UINT64_MAX && !(dropDeleted && lastValue.view() == DEL))
+        ok = emit(lastKey, lastValue);
+    if (ok && builder)
+        ok = finishTable();
+    if (!ok) {
+        // 输出写不完整或输入损坏，删除已经写出的部分（builder 析构时删除它的临时文件），输入没有移出原来的层
+        for (const sstablehead &out : outputs)
+            utils::rmfile(out.getFilename().data());
+        return false;
     }
 
-    // 下一层
-    std::vector<sstable> newSSTables;
-    skiplist tempList(0.5);
-    newSSTables.clear();
-    tempList.reset();
-    uint32_t currentBytes = 0;
-    if (mergedData.empty()) {
-        return true; // 合并后为空
-    }
-    for (const auto &entry : mergedData) {
-        // 插入
-        size_t maxSize = MAXSIZE - 32 - 10240;
-        if (maxSize < currentBytes + 12 + entry.second.size()) {
-            sstable newSST(&tempList);
-            newSSTables.push_back(newSST);
-            tempList.reset();
-            currentBytes = 0;
-        }
-        tempList.insert(entry.first, entry.second);
-        currentBytes = 12 + entry.second.size() + currentBytes;
-    }
-    // 剩余的数据从跳表转移到新文件
-    if (tempList.getBytes() > 0) {
-        sstable newSST(&tempList);
-        newSSTables.push_back(newSST);
-    }
-    // 检测是否成功转移
-    if (newSSTables.empty()) {
-        std::cout << "Warning: No valid SSTable generated after merging data." << std::endl;
-        return true;
+    // 两层的新内容在锁外准备好，持有独占锁时一起换入，读者要么只看到输入，要么只看到输出
+    levelupdate current = prepareLevel(curLevel, currentLevelSSTs, {});
+    levelupdate next    = prepareLevel(nextLevel, nextLevelOverlap, outputs);
+    {
+        std::lock_guard<std::shared_mutex> lock(tableLock);
+        totalLevel = std::max(totalLevel, nextLevel);
+        installLevel(current);
+        installLevel(next);
+        stats.compactions++; // 失败的不算
     }
 
+    // 输出全部写完之后再删除输入，中途崩溃最多留下重复的数据，不会丢数据。
+    // 输入已经换出，之后开始的读者不会再用到它们；getAsync 的候选持有文件句柄，删除后仍然可以读完。
+    // 全部是被丢掉的删除标记时 outputs 为空，输入文件仍然要删除
     for (auto &sst : currentLevelSSTs) {
         try {
             // 尝试删除文件
@@ -547,23 +1358,6 @@ bool KVStore::compaction(int curLevel) {
         }
     }
 
-    // 添加到下一层
-    int nextLevel         = curLevel + 1;
-    std::string targetDir = "./data/level-" + std::to_string(nextLevel) + "/";
-    // 目录如果不存在就新建
-    if (nextLevel > totalLevel) {
-        utils::mkdir((std::string("./data/level-") + std::to_string(nextLevel)).c_str());
-        totalLevel++;
-    }
-
-    for (auto &ss : newSSTables) {
-        std::string filename = getFile_newName(ss);
-        std::string url      = "./data/level-" + std::to_string(nextLevel) + "/" + filename;
-        ss.setFilename(url);
-        ss.putFile(url.data());
-        addsstable(ss, nextLevel);
-    }
-
     return true;
 }
 
@@ -575,29 +1369,116 @@ std::string KVStore::getFile_newName(sstable &ss) {
     return filename;
 }
 
-void KVStore::sortTable(int curLevel) {
+void KVStore::sortTable(std::vector<sstablehead> &tables) {
     auto compareFunction = [](const sstablehead &a, const sstablehead &b) {
         if (a.getTime() == b.getTime()) {
             return a.getMinV() < b.getMinV();
         }
         return a.getTime() < b.getTime();
     };
-    std::sort(sstableIndex[curLevel].begin(), sstableIndex[curLevel].end(), compareFunction);
+    std::sort(tables.begin(), tables.end(), compareFunction);
 }
 
-void KVStore::delsstable(std::string filename) {
-    for (int level = 0; level <= totalLevel; ++level) {
-        int size = sstableIndex[level].size(), flag = 0;
-        for (int i = 0; i < size; ++i) {
-            if (sstableIndex[level][i].getFilename() == filename) {
-                sstableIndex[level].erase(sstableIndex[level].begin() + i);
-                flag = 1;
-                break;
-            }
+void KVStore::arrangeLevel(int level) {
+    arrangeLevel(level, sstableIndex[level], levelOverlap[level], summary[level]);
+}
+
+void KVStore::arrangeLevel(int level, std::vector<sstablehead> &tables, bool &overlap, levelsummary &sum) {
+    overlap = false;
+    if (level == 0) {
+        sortTable(tables);
+        summarizeLevel(tables, sum);
+        return;
+    }
+    std::sort(tables.begin(), tables.end(), [](const sstablehead &a, const sstablehead &b) {
+        return a.getMinV() < b.getMinV();
+    });
+    for (int i = 1; i < (int)tables.size(); ++i) {
+        if (tables[i].getMinV() <= tables[i - 1].getMaxV())
+            overlap = true;
+    }
+    summarizeLevel(tables, sum);
+}
+
+// flusher 是唯一修改 sstableIndex 和摘要的线程，所以读它们不用持锁；摘要复制一份，在副本上更新
+KVStore::levelupdate KVStore::prepareLevel(
+    int level, const std::vector<sstablehead> &removed, const std::vector<sstablehead> &added) {
+    levelupdate update;
+    update.level = level;
+    update.sum   = summary[level];
+    std::unordered_set<std::string> gone;
+    for (const sstablehead &t : removed)
+        gone.insert(t.getFilename());
+    for (const sstablehead &t : sstableIndex[level]) {
+        if (!gone.count(t.getFilename()))
+            update.tables.push_back(t);
+    }
+    for (const sstablehead &t : added)
+        addsstable(t, update);
+    arrangeLevel(level, update.tables, update.overlap, update.sum);
+    return update;
+}
+
+void KVStore::installLevel(levelupdate &update) {
+    sstableIndex[update.level].swap(update.tables);
+    levelOverlap[update.level] = update.overlap;
+    std::swap(summary[update.level], update.sum);
+}
+
+/*
+ * 重新计算一层的 key 范围，需要时重建层过滤器。
+ * 过滤器只增不减：sstable 被合并走之后它的 key 还留在过滤器中，只会多一些误判，不会漏掉 key。
+ * 新写入这一层的 key 直接加进去（见 addsstable），放不下、或者失效的 key 超过一半时才重建，
+ * 重建时从各 sstable 的文件中读出 key 的哈希（见 sstablehead::loadHashes），开销分摊到写入这一层的 key 上。
+ * 打开数据库时同样从文件建起。层中有没有哈希的 sstable（TABLE_HASHES 之前写出的 TABLE_BLOCK）
+ * 或哈希读不出来时不用过滤器，只比较 key 范围，等这些 sstable 被合并掉之后再建。
+ */
+void KVStore::summarizeLevel(const std::vector<sstablehead> &tables, levelsummary &sum) {
+    sum.minKey    = UINT64_MAX;
+    sum.maxKey    = 0;
+    size_t live   = 0;
+    bool complete = true;
+    for (const sstablehead &t : tables) {
+        sum.minKey = std::min(sum.minKey, t.getMinV());
+        sum.maxKey = std::max(sum.maxKey, t.getMaxV());
+        complete   = complete && t.hasHashes();
+        live += t.getCnt();
+    }
+    if (complete && sum.filtered && !sum.dirty && sum.filter.size() <= 2 * live)
+        return;
+    sum.filtered = false;
+    sum.filter   = levelfilter();
+    if (!complete)
+        return;
+    sum.filter.build(std::max<size_t>(2 * live, 1024)); // 留出空间，之后写入的 sstable 直接加进来
+    std::vector<uint32_t> hashes;
+    for (const sstablehead &t : tables) {
+        if (!t.loadHashes(hashes)) {
+            sum.filter = levelfilter();
+            return;
         }
-        if (flag)
-            break;
+        for (uint32_t h : hashes)
+            sum.filter.add(h);
+    }
+    sum.filtered = true;
+    sum.dirty    = false;
+}
+
+bool KVStore::levelMayContain(int level, uint64_t key, uint32_t hash) {
+    const levelsummary &sum = summary[level];
+    if (key < sum.minKey || key > sum.maxKey)
+        return false;
+    if (sum.filtered && !sum.filter.mayContain(hash)) {
+        levelSkips++;
+        return false;
     }
+    return true;
+}
+
+void KVStore::delsstable(std::string filename) {
+    // 表头已经由 installLevel 从 sstableIndex 中换出
+    tables.evict(filename); // 关闭缓存的句柄
+    blockCache.evict(filename);
     int flag = utils::rmfile(filename.data());
     if (flag != 0) {
         std::cout << "delete fail!" << std::endl;
@@ -605,11 +1486,19 @@ void KVStore::delsstable(std::string filename) {
     }
 }
 
-void KVStore::addsstable(sstable ss, int level) {
-    sstableIndex[level].push_back(ss.getHead());
+// 新 sstable 的哈希刚写进文件，还在页缓存中，读回来加进层过滤器
+void KVStore::addsstable(const sstablehead &head, levelupdate &update) {
+    update.tables.push_back(head);
+    levelsummary &sum = update.sum;
+    std::vector<uint32_t> hashes;
+    if (sum.filtered && sum.filter.size() + head.getCnt() <= sum.filter.getCapacity() && head.loadHashes(hashes)) {
+        for (uint32_t h : hashes)
+            sum.filter.add(h);
+    } else {
+        sum.dirty = true; // 由 summarizeLevel 重建
+    }
 }
 
-char strBuf[2097152];
 
 /**
  * @brief Fetches a substring from a file starting at a given offset.
@@ -622,35 +1511,162 @@ char strBuf[2097152];
  * @param len The number of bytes to read from the file.
  * @return A string containing the read bytes.
  */
-std::string KVStore::fetchString(std::string file, int startOffset, uint32_t len) {
-    // TODO here
-    // open file in binary mode
-    std::ifstream headFile(file, std::ios::binary);
-    // test if the file is opened correctly
-    if (!headFile) {
-        std::cerr << "Error: Unable to open file " << file << std::endl;
+std::string KVStore::fetchString(const std::string &file, int startOffset, uint32_t len) {
+    // 文件句柄来自 table cache，命中时只剩一次 pread
+    std::shared_ptr<tablehandle> handle = tables.get(file);
+    if (!handle)
         return "";
+    if (handle->base) { // mmap 模式：直接从映射中拷出
+        if ((uint64_t)startOffset + len > handle->size) {
+            std::cerr << "Error: Unable to read " << len << " bytes from file " << file << std::endl;
+            return "";
+        }
+        return std::string(handle->base + startOffset, len);
+    }
+    // 直接读进返回的 string，没有全局缓冲区，可以多线程同时调用
+    std::string result(len, '\0');
+    uint32_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(handle->fd, result.data() + done, len - done, startOffset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            std::cerr << "Error: Unable to read " << len << " bytes from file " << file << std::endl;
+            return "";
+        }
+        done += n;
     }
-    // find the offset
-    headFile.seekg(startOffset, std::ios::beg);
-    // test if the offset is valid
-    if (!headFile) {
-        std::cerr << "Error: Unable to seek to the offset " << startOffset << std::endl;
-        return "";
+    return result;
+}
+
+std::vector<std::shared_ptr<const std::string>>
+KVStore::readBlocks(const sstablehead &table, const std::vector<int> &ids) {
+    const uint32_t MAX_GAP = 16 * 1024; // 两块之间的空隙不超过这么大时一起读，空隙读进 gap 后丢掉
+    const size_t MAX_IOV   = 64;
+    std::vector<std::shared_ptr<const std::string>> res(ids.size());
+    std::string file = table.getFilename();
+    std::vector<int> miss; // 不在缓存中的，ids 的下标
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (blockCache.getCapacity())
+            res[i] = blockCache.lookup(file, table.getBlock(ids[i]).offset);
+        if (!res[i])
+            miss.push_back(i);
+    }
+    if (miss.empty())
+        return res;
+
+    std::shared_ptr<tablehandle> handle = tables.get(file);
+    std::string gap;
+    for (size_t i = 0; i < miss.size();) {
+        BlockIndex first = table.getBlock(ids[miss[i]]);
+        uint64_t end     = (uint64_t)first.offset + first.size;
+        size_t j         = i + 1;
+        while (j < miss.size() && 2 * (j - i) < MAX_IOV) {
+            BlockIndex b = table.getBlock(ids[miss[j]]);
+            if (b.offset < end || b.offset - end > MAX_GAP)
+                break;
+            end = (uint64_t)b.offset + b.size;
+            j++;
+        }
+
+        std::vector<std::string> data(j - i);
+        bool done = false;
+        if (handle && !handle->base) { // mmap 模式下直接从映射中拷，不用 preadv
+            std::vector<struct iovec> iov;
+            uint64_t pos = first.offset;
+            for (size_t k = i; k < j; ++k) {
+                BlockIndex b = table.getBlock(ids[miss[k]]);
+                if (b.offset > pos) {
+                    gap.resize(MAX_GAP);
+                    iov.push_back({gap.data(), b.offset - pos});
+                }
+                data[k - i].resize(b.size);
+                iov.push_back({data[k - i].data(), b.size});
+                pos = (uint64_t)b.offset + b.size;
+            }
+            ssize_t n;
+            do {
+                n = ::preadv(handle->fd, iov.data(), iov.size(), first.offset);
+            } while (n < 0 && errno == EINTR);
+            done = n == (ssize_t)(end - first.offset); // 读不全时退回逐块读
+        }
+        for (size_t k = i; k < j; ++k) {
+            BlockIndex b = table.getBlock(ids[miss[k]]);
+            if (!done)
+                data[k - i] = fetchString(file, b.offset, b.size);
+            if (data[k - i].size() != b.size || !checkBlock(table, b, data[k - i].data(), b.size) ||
+                !decodeBlock(table, b, data[k - i]))
+                continue; // 留下空指针，调用者当作损坏的块，不放进缓存
+            auto block   = std::make_shared<const std::string>(std::move(data[k - i]));
+            res[miss[k]] = block;
+            blockCache.insert(file, b.offset, block);
+        }
+        i = j;
     }
-    // read the string
-    headFile.read(strBuf, len);
-    // test if it is successful to read
-    if (!headFile) {
-        std::cerr << "Error: Unable to read " << len << " bytes from file" << std::endl;
-        return "";
+    return res;
+}
+
+valueref KVStore::fetchRef(const std::string &file, int startOffset, uint32_t len) {
+    if (options.mmapReads) {
+        std::shared_ptr<tablehandle> handle = tables.get(file);
+        if (handle && handle->base && (uint64_t)startOffset + len <= handle->size)
+            return valueref(handle, handle->base + startOffset, len); // 持有句柄，映射一直有效
     }
-    // transfer to string
-    std::string result(strBuf, len);
-    // close file
-    headFile.close();
-    // return
-    return result;
+    return valueref(fetchString(file, startOffset, len));
+}
+
+blockiter KVStore::openBlock(const sstablehead &table, int block) {
+    if (options.mmapReads) {
+        BlockIndex b                        = table.getBlock(block);
+        std::shared_ptr<tablehandle> handle = tables.get(table.getFilename());
+        if (handle && handle->base && (uint64_t)b.offset + b.size <= handle->size) {
+            const char *data = handle->base + b.offset;
+            if (!checkBlock(table, b, data, b.size))
+                return blockiter(nullptr); // corrupted() 为真
+            if (!table.isCompressed())
+                return blockiter(handle, data, b.size);
+            if (b.size && data[b.size - 1] == BLOCK_RAW) // 没有压缩的块仍然直接在映射上迭代
+                return blockiter(handle, data, b.size - 1);
+            std::string block(data, b.size);
+            if (!decodeBlock(table, b, block))
+                return blockiter(nullptr);
+            return blockiter(std::make_shared<const std::string>(std::move(block)));
+        }
+    }
+    return blockiter(readBlock(table, block));
+}
+
+bool KVStore::checkBlock(const sstablehead &table, const BlockIndex &b, const char *data, size_t len) const {
+    if (!options.verifyChecksums || !table.hasChecksums() || len != b.size) // 读不全的由调用者处理
+        return true;
+    if (crc32c::value(data, len) == b.crc)
+        return true;
+    std::cerr << "Error: Checksum mismatch in block at offset " << b.offset << " of file " << table.getFilename()
+              << std::endl;
+    return false;
+}
+
+bool KVStore::decodeBlock(const sstablehead &table, const BlockIndex &b, std::string &data) const {
+    if (!table.isCompressed() || data.size() != b.size)
+        return true;
+    if (uncompressBlock(data))
+        return true;
+    std::cerr << "Error: Corrupted block at offset " << b.offset << " of file " << table.getFilename() << std::endl;
+    return false;
+}
+
+std::shared_ptr<const std::string> KVStore::readBlock(const sstablehead &table, int block) {
+    BlockIndex b     = table.getBlock(block);
+    std::string file = table.getFilename();
+    std::shared_ptr<const std::string> res;
+    if (blockCache.getCapacity() && (res = blockCache.lookup(file, b.offset)))
+        return res; // 缓存中的块放进去之前校验过
+    std::string data = fetchString(file, b.offset, b.size); // 读不全时已经报过错
+    if (data.size() != b.size || !checkBlock(table, b, data.data(), b.size) || !decodeBlock(table, b, data))
+        return nullptr;
+    res = std::make_shared<const std::string>(std::move(data));
+    blockCache.insert(file, b.offset, res);
+    return res;
 }
 
 std::vector<std::pair<std::uint64_t, std::string>> KVStore::search_knn(std::string query, int k) {
@@ -1222,34 +2238,17 @@ void KVStore::read_build_from_text(const std::string &string_path, const std::st
                 total_insertNode_time_us += duration_cast<microseconds>(end_insertNode - start_insertNode).count();
 
                 auto start_memInsert = high_resolution_clock::now();
-                uint32_t nxtsize     = s->getBytes();
-                std::string res      = s->search(count);
-                if (!res.length()) {
-                    nxtsize += 12 + textLine.length();
-                } else {
-                    nxtsize = nxtsize - res.length() + textLine.length();
-                }
-
-                if (nxtsize + 10240 + 32 <= MAXSIZE) {
-                    s->insert(count, textLine);
-                } else {
-                    auto start_compact = high_resolution_clock::now();
-                    sstable ss(s);
-                    s->reset();
-                    std::string url  = ss.getFilename();
-                    std::string path = "./data/level-0";
-                    if (!utils::dirExists(path)) {
-                        utils::mkdir(path.data());
-                        totalLevel = 0;
+                {
+                    // memtable 写满后由后台线程落盘，这里只统计切换次数和等待时间
+                    writer w;
+                    wal::appendEntry(w.entries, WAL_PUT, count, textLine);
+                    w.count = 1;
+                    w.embed = false; // 向量已经从文件中读出
+                    if (commit(w)) {
+                        total_compact_time_ms +=
+                            duration_cast<milliseconds>(high_resolution_clock::now() - start_memInsert).count();
+                        ++compact_count;
                     }
-                    addsstable(ss, 0);
-                    ss.putFile(url.data());
-                    compaction();
-                    auto end_compact = high_resolution_clock::now();
-                    total_compact_time_ms += duration_cast<milliseconds>(end_compact - start_compact).count();
-                    ++compact_count;
-
-                    s->insert(count, textLine);
                 }
                 auto end_memInsert = high_resolution_clock::now();
                 total_memInsert_time_us += duration_cast<microseconds>(end_memInsert - start_memInsert).count();
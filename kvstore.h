@@ -1,22 +1,37 @@
 #pragma once
 
+#include "block.h"
+#include "blockcache.h"
+#include "ioqueue.h"
 #include "kvstore_api.h"
-#include "skiplist.h"
+#include "levelfilter.h"
+#include "memtable.h"
+#include "options.h"
 #include "sstable.h"
 #include "sstablehead.h"
+#include "tablecache.h"
 #include "threadpool.h"
+#include "valueref.h"
+#include "wal.h"
+#include "write_batch.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <future>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <set>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -466,18 +481,131 @@ public:
     }
 };
 
+/*
+ * 点查的结果。READ_CORRUPTED 表示可能含有 key 的数据块读不出来、校验或解压失败、格式不对：
+ * 这时不知道 key 在这一层的值，不能再去查更旧的层，否则可能返回旧值或已经删除的 key。
+ */
+enum READ_STATUS {
+    READ_NOT_FOUND,
+    READ_FOUND,
+    READ_CORRUPTED
+};
+
 class KVStore : public KVStoreAPI {
     // You can add your implementation here
+public:
+    struct Stats {
+        uint64_t flushes     = 0; // memtable 写成 level-0 的次数
+        uint64_t flushBytes  = 0; // 这些 level-0 sstable 的总大小
+        uint64_t flushMemory = 0; // 这些 memtable 落盘前占用的内存
+        uint64_t compactions = 0; // 实际发生合并的层数之和
+        uint64_t readErrors  = 0; // 因为数据块损坏或读不出来而失败的点查（每个 key 一次）和 scan
+        uint64_t cacheHits   = 0; // block cache 命中的次数
+        uint64_t cacheMisses = 0; // block cache 未命中、读了文件的次数
+        size_t cacheUsage    = 0; // block cache 当前占用的内存
+        uint64_t levelSkips  = 0; // 点查时 key 在一层的范围内、被层过滤器排除的次数
+    };
+
 private:
-    skiplist *s = new skiplist(0.5); // memtable
+    memtable *s = nullptr;      // 由 options.memtable 决定实现
+    std::deque<memtable *> imm; // 已写满、等待后台落盘的 memtable，越靠后越新
     // std::vector<sstablehead> sstableIndex;  // sstable的表头缓存
 
     std::vector<sstablehead> sstableIndex[15]; // the sshead for each level
+    // level-0 按时间戳从旧到新排列；其余各层按 minV 排列，互不重叠，见 arrangeLevel
+    bool levelOverlap[15] = {}; // 该层（≥1）是否有 key 范围重叠的 sstable，只在 compaction 中途崩溃后出现
+
+    struct levelsummary { // 一层的摘要，查不存在的 key 时一次判断跳过整层，见 summarizeLevel
+        uint64_t minKey = UINT64_MAX; // 该层所有 sstable 的 key 范围
+        uint64_t maxKey = 0;
+        bool filtered   = false; // filter 是否覆盖了该层所有的 key
+        bool dirty      = false; // 有新加入的 sstable 没能放进 filter，需要重建
+        levelfilter filter;
+    };
+    levelsummary summary[15];
+    struct levelupdate { // 一层的新内容，flusher 在锁外排好序、算好摘要，见 prepareLevel
+        int level = 0;
+        std::vector<sstablehead> tables;
+        bool overlap = false;
+        levelsummary sum;
+    };
+    std::atomic<uint64_t> levelSkips{0}; // Stats::levelSkips，读者只持共享锁，单独计数
 
     int totalLevel = -1; // 层数
     std::vector<std::string> tmp_vec;
     std::vector<uint64_t> tmp_key;
 
+    std::mutex memLock;                // 保护 s、imm、tmp_vec、tmp_key
+    // 保护 sstableIndex、totalLevel 以及磁盘上的 sstable，get/scan 只持共享锁。
+    // 只有 flusher 修改它们，所以 flusher 不持锁读，写 sstable 和合并时也不持锁，只在换入结果时持独占锁
+    std::shared_mutex tableLock;
+    std::condition_variable flushCond; // 通知 flusher 有新的 imm
+    std::condition_variable immCond;   // 通知写者 imm 已经落盘
+    bool stopFlush = false;
+    std::thread flusher;
+
+    struct writer { // 排队等待提交的写请求
+        std::string entries; // 写前日志中的条目
+        uint32_t count = 0;    // 为 0 的是 reset()：不与其它请求合并，排到队首时独占日志
+        bool embed     = true; // 是否放入 tmp_vec/tmp_key 等待向量化
+        bool done      = false;
+        bool rotated   = false;   // 这次提交是否切换了 memtable
+        memtable *mem  = nullptr; // concurrent() 的 memtable：提交之后由写者自己在 memLock 之外插入
+        uint64_t seq   = 0;       // 第一个条目的序号，见 memSeq
+        std::condition_variable cond;
+    };
+
+    Options options;
+    std::string walDir;
+    wal log;                      // 当前 memtable 的写前日志
+    uint64_t logNumber = 0;       // 当前日志的编号
+    std::deque<uint64_t> immLogs; // 与 imm 一一对应的日志编号
+    std::deque<writer *> writers; // 等待提交的写请求，队首负责提交
+    uint64_t memSeq = 1;          // 按日志顺序给每个条目的序号，并发插入同一个 key 时据此保留后写的，由 memLock 保护
+    Stats stats;                  // 由 tableLock 保护
+    tablecache tables;            // 打开的 sstable 文件
+    blockcache blockCache;        // 最近读过的数据块
+    std::unique_ptr<ioqueue> io;  // getAsync 的异步读，第一次调用时创建；析构时先于上面的成员等待在途的读完成
+    std::once_flag ioOnce;
+    std::atomic<uint64_t> readErrors{0}; // Stats::readErrors，读者只持共享锁，单独计数
+
+    struct asyncGet;                               // 一次 getAsync 的状态，见 kvstore.cc
+    void continueGet(std::shared_ptr<asyncGet> g); // 依次查 g 的候选，需要读文件时提交异步读后返回
+
+    bool commit(writer &w); // 写日志并写入 memtable，返回是否切换了 memtable
+    // lock 为调用者持有的 memLock
+    bool makeRoom(const std::string &entries, uint32_t count, std::unique_lock<std::mutex> &lock);
+    void applyEntries(const std::string &entries, bool embed); // 调用者持有 memLock
+    void insertEntries(writer &w);                             // 不持有 memLock，把 w 插入 w.mem
+    void flushLoop();
+    bool flushMemtable(memtable *mem); // 由 flusher 调用，写 sstable 失败时返回 false
+    std::string logName(uint64_t number);
+    void recover(); // 重放写前日志
+    int memtableState(uint64_t key);
+    std::string memtableGet(uint64_t key); // 从新到旧查 memtable 和 imm，没找到为空串
+    READ_STATUS sstableGet(uint64_t key, valueref &val); // 逐层查 sstable，删除标记也是 READ_NOT_FOUND
+    READ_STATUS tableGet(const sstablehead &table, uint64_t key, valueref &val); // 在一个 sstable 中点查
+    READ_STATUS levelGet(int level, uint64_t key, valueref &val); // 在一层中点查，调用者持有 tableLock
+    void arrangeLevel(int level); // 恢复 sstableIndex[level] 的顺序并更新摘要，调用者持有 tableLock
+    void arrangeLevel(int level, std::vector<sstablehead> &tables, bool &overlap, levelsummary &sum);
+    void summarizeLevel(const std::vector<sstablehead> &tables, levelsummary &sum);
+    // 在 level 当前的内容上去掉 removed、加上 added，不持锁，只能由 flusher 调用
+    levelupdate prepareLevel(int level, const std::vector<sstablehead> &removed, const std::vector<sstablehead> &added);
+    void addsstable(const sstablehead &head, levelupdate &update); // 将 head 加入 update
+    void installLevel(levelupdate &update);                        // 调用者持有 tableLock 的独占锁
+    bool levelMayContain(int level, uint64_t key, uint32_t hash); // hash 为 levelfilter::hash(key)
+    // 在一个 sstable 中查 keys[idx[i]]（按 key 递增），结果写进 res 和 status，没找到的下标放进 missed
+    void tableMultiGet(
+        const sstablehead &table,
+        const std::vector<uint64_t> &keys,
+        const std::vector<int> &idx,
+        std::vector<std::string> &res,
+        std::vector<READ_STATUS> &status,
+        std::vector<int> &missed
+    );
+    // 读一个 sstable 的多个块（块号递增），不在缓存中的相邻块合成一次 preadv，读不出来或损坏的块为空指针
+    std::vector<std::shared_ptr<const std::string>> readBlocks(const sstablehead &table, const std::vector<int> &ids);
+
 public:
     // buffer-tmp-map
     std::unordered_map<uint64_t, std::vector<float>> bufferMap;
@@ -487,7 +615,7 @@ public:
 
     SearchLayers searchRoute;
 
-    KVStore(const std::string &dir);
+    KVStore(const std::string &dir, const Options &options = Options());
 
     ~KVStore();
 
@@ -495,23 +623,61 @@ public:
 
     std::string get(uint64_t key) override;
 
+    // 不拷贝 value 的 get，找到时返回 true，value 引用 block cache 中的块或 mmap 的文件，见 valueref
+    bool get(uint64_t key, valueref &value);
+
+    // 与上面的 get 相同，但区分没找到和读到损坏的数据（READ_CORRUPTED，此时 value 为空）。
+    // 返回字符串的接口读到损坏的数据时返回空串，只能从 getStats 的 readErrors 和错误输出中看出来
+    READ_STATUS lookup(uint64_t key, valueref &value);
+
+    // 一次查多个 key，结果与 keys 一一对应，没找到为空串；status 为每个 key 的 READ_STATUS
+    std::vector<std::string> multiGet(const std::vector<uint64_t> &keys);
+    std::vector<std::string> multiGet(const std::vector<uint64_t> &keys, std::vector<READ_STATUS> &status);
+
+    // 异步点查，callback 收到 value，没找到为空串。memtable 或 block cache 命中时在调用线程中直接回调，
+    // 否则把读文件交给 io_uring（不可用时为线程池），在后台线程中回调，回调中不要做耗时的事
+    void getAsync(uint64_t key, std::function<void(std::string)> callback);
+    void getAsync(uint64_t key, std::function<void(READ_STATUS, std::string)> callback);
+    std::future<std::string> getAsync(uint64_t key);
+
     bool del(uint64_t key) override;
 
+    void write(const WriteBatch &batch); // 原子地写入一组 put/del，MEMTABLE_CONCURRENT 时见 write_batch.h
+
+    Stats getStats();   // 落盘和合并的统计
+    void waitFlushed(); // 等待所有 imm 落盘
+    size_t memtableMemory(); // memtable 和 imm 占用的内存
+
     void reset() override;
 
     void scan(uint64_t key1, uint64_t key2, std::list<std::pair<uint64_t, std::string>> &list) override;
 
+    // 结果追加到 out 的末尾，value 不拷贝
+    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, valueref>> &out);
+
+    // 按 key 递增对每个结果调用 callback，返回 false 时停止。遇到损坏的数据块时报错并停止，见 Stats::readErrors。
+    // callback 在持有 tableLock 时调用，其中不能写入 KVStore，否则可能与后台落盘死锁
+    void scan(uint64_t key1, uint64_t key2, const std::function<bool(uint64_t, const valueref &)> &callback);
+
     void compaction();
-    bool compaction(int level);
+    bool compaction(int level); // 由 flusher 调用，只在换入结果时持有 tableLock
 
-    void delsstable(std::string filename);  // 从缓存中删除filename.sst， 并物理删除
-    void addsstable(sstable ss, int level); // 将ss加入缓存
+    void delsstable(std::string filename); // 从缓存中删除filename.sst， 并物理删除
 
-    std::string fetchString(std::string file, int startOffset, uint32_t len);
+    std::string fetchString(const std::string &file, int startOffset, uint32_t len);
+    // 读一个数据块，读不出来、校验或解压失败时返回空指针
+    std::shared_ptr<const std::string> readBlock(const sstablehead &table, int block);
+    valueref fetchRef(const std::string &file, int startOffset, uint32_t len); // mmap 模式下不拷贝
+    // mmap 模式下直接在映射上迭代，否则经过 readBlock；读不出来的块得到 corrupted() 的迭代器
+    blockiter openBlock(const sstablehead &table, int block);
+    // options.verifyChecksums 打开时校验从文件读出的块，不一致时报错并返回 false
+    bool checkBlock(const sstablehead &table, const BlockIndex &b, const char *data, size_t len) const;
+    // 压缩的 sstable 中读到的块就地解压，失败时报错并返回 false
+    bool decodeBlock(const sstablehead &table, const BlockIndex &b, std::string &data) const;
 
     static std::string getFile_newName(sstable &ss);
 
-    void sortTable(int curLevel);
+    static void sortTable(std::vector<sstablehead> &tables);
 
     std::vector<std::pair<std::uint64_t, std::string>> search_knn(std::string query, int k); // use as similarity
 
@@ -0,0 +1,41 @@
+#include "levelfilter.h"
+
+#include "MurmurHash3.h"
+
+#include <algorithm>
+
+uint32_t levelfilter::hash(uint64_t key) {
+    return fmix64(key);
+}
+
+void levelfilter::build(size_t capacity) {
+    this->capacity = capacity;
+    count          = 0;
+    bits.assign(std::max<size_t>(1, (capacity * BITS_PER_KEY + 63) / 64), 0);
+}
+
+// 与 LevelDB 相同的双重哈希：由一个哈希值不断加上 delta 得到各个探测位置
+void levelfilter::add(uint32_t h) {
+    uint64_t n     = bits.size() * 64;
+    uint32_t delta = (h >> 17) | (h << 15);
+    for (int i = 0; i < PROBES; ++i) {
+        uint64_t p = h % n;
+        bits[p / 64] |= 1ULL << (p % 64);
+        h += delta;
+    }
+    count++;
+}
+
+bool levelfilter::mayContain(uint32_t h) const {
+    if (bits.empty())
+        return true; // 还没有 build
+    uint64_t n     = bits.size() * 64;
+    uint32_t delta = (h >> 17) | (h << 15);
+    for (int i = 0; i < PROBES; ++i) {
+        uint64_t p = h % n;
+        if (!(bits[p / 64] >> (p % 64) & 1))
+            return false;
+        h += delta;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef LSM_KV_LEVELFILTER_H
+#define LSM_KV_LEVELFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * 覆盖一整层 sstable 的 bloom filter，点查时一次判断就能跳过整层。
+ * 大小按容纳的 key 数决定（每个 key 10 bit，误判率约 1%），不像 sstable 自带的 bloom 那样固定 10240 字节。
+ * 只接受 key 的 32 位哈希，同一个 key 在各层只需要算一次哈希。
+ * 哈希随 sstable 写进文件（见 sstablehead.h 的 TABLE_HASHES），hash 的算法不能再改。
+ */
+class levelfilter {
+private:
+    static const int BITS_PER_KEY = 10;
+    static const int PROBES       = 6; // ln2 * BITS_PER_KEY
+
+    std::vector<uint64_t> bits;
+    size_t capacity = 0; // 最多放入的 key 数，超过后误判率变高
+    size_t count    = 0; // 已放入的 key 数
+
+public:
+    static uint32_t hash(uint64_t key);
+
+    void build(size_t capacity); // 清空，并按 capacity 个 key 分配空间
+    void add(uint32_t h);
+    bool mayContain(uint32_t h) const;
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t memoryUsage() const {
+        return bits.size() * sizeof(uint64_t);
+    }
+};
+
+#endif // LSM_KV_LEVELFILTER_H
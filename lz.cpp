@@ -0,0 +1,242 @@
+#include "lz.h"
+
+#include "coding.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace lz {
+namespace {
+const size_t MIN_MATCH    = 4;
+const size_t MAX_DISTANCE = 65535;
+const int MAX_HASH_BITS   = 14;
+const int HIGH_ATTEMPTS   = 64; // HIGH 在一条哈希链上最多试的候选数
+const size_t SLACK        = 16; // 解压时输出缓冲多留的字节
+
+uint32_t read32(const char *p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+uint32_t hash4(uint32_t v, int bits) {
+    return (v * 2654435761u) >> (32 - bits);
+}
+
+// a 在 b 之前，从这两处往后有多少字节相同，不超过 end
+size_t matchLength(const char *a, const char *b, const char *end) {
+    const char *start = b;
+    while (b + 8 <= end) {
+        uint64_t x, y;
+        std::memcpy(&x, a, 8);
+        std::memcpy(&y, b, 8);
+        if (x != y)
+            return b - start + (__builtin_ctzll(x ^ y) >> 3); // 小端，最低的不同字节
+        a += 8;
+        b += 8;
+    }
+    while (b < end && *a == *b) {
+        a++;
+        b++;
+    }
+    return b - start;
+}
+
+char *putLength(char *op, size_t len) { // token 中放不下的部分
+    while (len >= 255) {
+        *op++ = (char)255;
+        len -= 255;
+    }
+    *op++ = (char)len;
+    return op;
+}
+
+// 在 op 处写一个序列，返回写完的位置；matchLen 为 0 时是只有字面量的最后一个序列
+char *emit(char *op, const char *lit, size_t litLen, size_t distance, size_t matchLen) {
+    size_t extra = matchLen ? matchLen - MIN_MATCH : 0;
+    *op++        = (char)(std::min<size_t>(litLen, 15) << 4 | std::min<size_t>(extra, 15));
+    if (litLen >= 15)
+        op = putLength(op, litLen - 15);
+    std::memcpy(op, lit, litLen);
+    op += litLen;
+    if (!matchLen)
+        return op;
+    *op++ = (char)(distance & 0xff);
+    *op++ = (char)(distance >> 8);
+    if (extra >= 15)
+        op = putLength(op, extra - 15);
+    return op;
+}
+
+int hashBits(size_t n) { // 小块用小的哈希表，清空的开销与块大小相当
+    int bits = 8;
+    while (bits < MAX_HASH_BITS && ((size_t)1 << bits) < n)
+        bits++;
+    return bits;
+}
+
+char *compressFast(const char *src, size_t n, char *op) {
+    static thread_local std::vector<uint32_t> table;
+    int bits = hashBits(n);
+    table.assign((size_t)1 << bits, 0);
+    size_t anchor   = 0, pos = 0, limit = n - MIN_MATCH; // pos <= limit 时还能读 4 字节
+    unsigned misses = 0;
+    while (pos <= limit) {
+        uint32_t v  = read32(src + pos);
+        uint32_t &h = table[hash4(v, bits)];
+        size_t cand = h;
+        h           = pos;
+        if (cand < pos && pos - cand <= MAX_DISTANCE && read32(src + cand) == v) {
+            size_t len = MIN_MATCH + matchLength(src + cand + MIN_MATCH, src + pos + MIN_MATCH, src + n);
+            while (pos > anchor && cand > 0 && src[pos - 1] == src[cand - 1]) { // 向前扩展
+                pos--;
+                cand--;
+                len++;
+            }
+            op = emit(op, src + anchor, pos - anchor, pos - cand, len);
+            pos += len;
+            anchor = pos;
+            misses = 0;
+            if (pos - 2 <= limit) // 匹配末尾的位置也记下，下一个匹配常常从这里开始
+                table[hash4(read32(src + pos - 2), bits)] = pos - 2;
+        } else {
+            pos += 1 + (misses++ >> 5); // 连续找不到匹配时跳得越来越快
+        }
+    }
+    return emit(op, src + anchor, n - anchor, 0, 0);
+}
+
+char *compressHigh(const char *src, size_t n, char *op) {
+    static thread_local std::vector<int32_t> head, prev;
+    int bits = hashBits(n) + 1;
+    head.assign((size_t)1 << bits, -1);
+    prev.resize(n);
+    size_t limit = n - MIN_MATCH;
+    auto insert  = [&](size_t p) {
+        uint32_t h = hash4(read32(src + p), bits);
+        prev[p]    = head[h];
+        head[h]    = p;
+    };
+    auto find = [&](size_t p, size_t &best) { // p 之前最长的匹配，返回长度，不足 MIN_MATCH 时为 0
+        size_t len   = 0;
+        uint32_t v   = read32(src + p);
+        int attempts = HIGH_ATTEMPTS;
+        for (int32_t c = head[hash4(v, bits)]; c >= 0 && p - c <= MAX_DISTANCE && attempts--; c = prev[c]) {
+            if (src[c + len] != src[p + len] || read32(src + c) != v) // 先比较会决定胜负的那个字节
+                continue;
+            size_t l = MIN_MATCH + matchLength(src + c + MIN_MATCH, src + p + MIN_MATCH, src + n);
+            if (l > len) {
+                len  = l;
+                best = c;
+                if (p + len == n)
+                    break;
+            }
+        }
+        return len;
+    };
+
+    size_t anchor = 0, pos = 0;
+    while (pos <= limit) {
+        size_t cand = 0, len = find(pos, cand);
+        insert(pos);
+        if (len < MIN_MATCH) {
+            pos++;
+            continue;
+        }
+        while (pos + 1 <= limit) { // lazy 匹配：下一个位置的匹配更长时先输出一个字面量
+            size_t next = 0, l = find(pos + 1, next);
+            if (l <= len)
+                break;
+            pos++;
+            insert(pos);
+            cand = next;
+            len  = l;
+        }
+        op = emit(op, src + anchor, pos - anchor, pos - cand, len);
+        for (size_t p = pos + 1; p < pos + len && p <= limit; ++p)
+            insert(p);
+        pos += len;
+        anchor = pos;
+    }
+    return emit(op, src + anchor, n - anchor, 0, 0);
+}
+
+bool getLength(const char *&p, const char *end, size_t &len) {
+    unsigned char b;
+    do {
+        if (p >= end)
+            return false;
+        b = *p++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+} // namespace
+
+void compress(const char *src, size_t n, std::string &dst, int level) {
+    dst.clear();
+    putVarint64(dst, n);
+    size_t head = dst.size();
+    dst.resize(head + n + n / 255 + 16); // 最坏情况下全是字面量
+    char *op = dst.data() + head;
+    if (n < MIN_MATCH + 1)
+        op = emit(op, src, n, 0, 0);
+    else if (level >= HIGH)
+        op = compressHigh(src, n, op);
+    else
+        op = compressFast(src, n, op);
+    dst.resize(op - dst.data());
+}
+
+bool uncompress(const char *src, size_t n, std::string &dst) {
+    const char *p = src, *end = src + n;
+    uint64_t size;
+    p = getVarint64(p, end, &size);
+    if (!p || size > (uint64_t)n * 255) // 每个输入字节最多展开成 255 字节，挡住损坏的长度
+        return false;
+    dst.resize(size + SLACK); // 短的复制一次复制 16 字节，可能写过结尾
+    char *out = dst.data(), *o = out, *oend = out + size;
+    while (p < end) {
+        unsigned token = (unsigned char)*p++;
+        size_t lit     = token >> 4;
+        if (lit == 15 && !getLength(p, end, lit))
+            return false;
+        if (lit > (size_t)(end - p) || lit > (size_t)(oend - o))
+            return false;
+        if (lit <= 16 && end - p >= 16)
+            std::memcpy(o, p, 16);
+        else
+            std::memcpy(o, p, lit);
+        o += lit;
+        p += lit;
+        if (p == end) { // 最后一个序列
+            dst.resize(size);
+            return o == oend;
+        }
+        if (end - p < 2)
+            return false;
+        size_t distance = (unsigned char)p[0] | (size_t)(unsigned char)p[1] << 8;
+        p += 2;
+        size_t len = token & 15;
+        if (len == 15 && !getLength(p, end, len))
+            return false;
+        len += MIN_MATCH;
+        if (distance == 0 || distance > (size_t)(o - out) || len > (size_t)(oend - o))
+            return false;
+        const char *m = o - distance;
+        if (distance >= 8 && len <= 16) { // 8 字节一组，组内不会读到本次写的内容
+            std::memcpy(o, m, 8);
+            std::memcpy(o + 8, m + 8, 8);
+        } else if (distance >= len) {
+            std::memcpy(o, m, len);
+        } else { // 与输出重叠，逐字节复制
+            for (size_t i = 0; i < len; ++i)
+                o[i] = m[i];
+        }
+        o += len;
+    }
+    return false;
+}
+} // namespace lz
@@ -0,0 +1,23 @@
+#ifndef LSM_KV_LZ_H
+#define LSM_KV_LZ_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * 内置的 LZ77 压缩，用来压缩 sstable 的数据块，不依赖外部库。格式与 LZ4 的块格式类似：
+ *   [varint 原长][序列]...，序列 = [token][字面量长度扩展][字面量][u16 匹配距离][匹配长度扩展]。
+ * token 高 4 位是字面量长度，低 4 位是匹配长度减 4；为 15 时后面的字节继续累加，字节为 255 表示还有。
+ * 最后一个序列只有字面量。匹配距离不超过 65535，两种级别压缩的结果都用 uncompress 解压。
+ */
+namespace lz {
+enum LEVEL {
+    FAST = 1, // 每个位置只试一个候选，难压缩的数据上逐渐加大步长
+    HIGH = 2  // 沿哈希链试多个候选，并且看下一个位置有没有更长的匹配，慢几倍，结果更小
+};
+
+void compress(const char *src, size_t n, std::string &dst, int level = FAST); // 结果写进 dst，覆盖原有内容
+bool uncompress(const char *src, size_t n, std::string &dst);                  // 数据损坏时返回 false
+} // namespace lz
+
+#endif // LSM_KV_LZ_H
@@ -0,0 +1,19 @@
+#include "memtable.h"
+
+#include "concurrent_skiplist.h"
+#include "hash_skiplist.h"
+#include "skiplist.h"
+#include "vector_memtable.h"
+
+memtable *newMemtable(MEMTABLE_TYPE type) {
+    switch (type) {
+    case MEMTABLE_HASH_SKIPLIST:
+        return new hash_skiplist();
+    case MEMTABLE_VECTOR:
+        return new vector_memtable();
+    case MEMTABLE_CONCURRENT:
+        return new concurrent_skiplist();
+    default:
+        return new skiplist(0.5);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef LSM_KV_MEMTABLE_H
+#define LSM_KV_MEMTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum MEMTABLE_TYPE {
+    MEMTABLE_SKIPLIST,      // 有序跳表，读写都是 O(log n)
+    MEMTABLE_HASH_SKIPLIST, // 跳表加哈希索引，点查 O(1)，适合以 get 为主的负载
+    MEMTABLE_VECTOR,        // 只追加的数组，读或落盘时才排序，适合批量导入
+    MEMTABLE_CONCURRENT     // CAS 跳表，多个线程同时 put 时在 memLock 之外并发插入，见 KVStore::commit
+};
+
+// 按 key 从小到大遍历 memtable，同一个 key 只出现一次（最新的值）
+class memiter {
+public:
+    virtual ~memiter() {}
+
+    virtual bool valid()      = 0;
+    virtual void next()       = 0;
+    virtual uint64_t key()    = 0;
+    virtual const char *val() = 0;
+    virtual uint32_t len()    = 0;
+
+    std::string value() {
+        return std::string(val(), len());
+    }
+};
+
+/*
+ * memtable 接口。KVStore 的 put/get/scan 和 sstable 的构造都只通过它访问内存中的数据，
+ * 具体实现由 Options::memtable 在构造 KVStore 时选择。
+ * 实现不需要线程安全，KVStore 用 memLock 保护所有访问；concurrent() 为真的实现例外，
+ * 它的 upsertOrdered 在 memLock 之外调用，可以与其它写入以及 find、scan 同时进行。
+ */
+class memtable {
+public:
+    virtual ~memtable() {}
+
+    // 插入或更新，返回 getBytes() 的变化量
+    virtual int64_t upsert(uint64_t key, const std::string &str) = 0;
+    // 找到时 val/len 指向 memtable 内部的 value，不拷贝，下一次 reset 之前有效
+    virtual bool find(uint64_t key, const char *&val, uint32_t &len) = 0;
+    virtual void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) = 0;
+    virtual std::unique_ptr<memiter> begin() = 0;
+    virtual void reset()                     = 0;
+    virtual uint32_t getBytes()              = 0; // 落盘后的大小（不含文件头和 bloom filter）
+    virtual size_t memoryUsage()             = 0; // 实际占用的内存
+
+    virtual bool concurrent() {
+        return false;
+    }
+
+    // 同一个 key 的写入按 seq 生效，seq 小的写入后到时被丢掉，结果与日志中的顺序一致。
+    // 只有 concurrent() 的实现需要覆盖，其余的实现由 memLock 保证顺序
+    virtual int64_t upsertOrdered(uint64_t key, const std::string &str, uint64_t /*seq*/) {
+        return upsert(key, str);
+    }
+
+    // KVStore 在 memLock 之外写入时用：还没插完的写者数，和它们最多会让 getBytes() 增加的字节数。
+    // 都在 memLock 中增加，写者插完之后减去；flush 之前等 writers 归零
+    std::atomic<int> writers{0};
+    std::atomic<uint64_t> pendingBytes{0};
+
+    std::string search(uint64_t key) {
+        const char *val;
+        uint32_t len;
+        if (find(key, val, len))
+            return std::string(val, len);
+        return "";
+    }
+};
+
+memtable *newMemtable(MEMTABLE_TYPE type);
+
+#endif // LSM_KV_MEMTABLE_H
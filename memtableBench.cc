@@ -0,0 +1,118 @@
+#include "concurrent_skiplist.h"
+#include "skiplist.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * memtable 多线程吞吐测试：
+ *   skiplist + mutex       单线程跳表，所有线程共用一把锁
+ *   concurrent_skiplist    CAS 跳表，写者之间、读者之间都不加锁
+ * 每一轮把同一批乱序 key 平均分给 T 个线程，分别测 put 和 get 的吞吐。
+ * 最后单线程测 skiplist 在不同规模下随机 get 的平均延迟。
+ */
+
+const int VALUE_SIZE = 64;
+
+template <class F>
+double runThreads(int threads, uint64_t total, F &&work) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        uint64_t begin = total * t / threads;
+        uint64_t end   = total * (t + 1) / threads;
+        workers.emplace_back([&work, begin, end] { work(begin, end); });
+    }
+    for (auto &w : workers)
+        w.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    double s = std::chrono::duration<double>(end - start).count();
+    return total / s / 1e6; // Mops/s
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t total = 200000;
+    if (argc == 2)
+        total = std::stoull(argv[1]);
+
+    std::cout << "Usage: " << argv[0] << " [number of keys]" << std::endl;
+    std::cout << "keys: " << total << ", value size: " << VALUE_SIZE
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl
+              << std::endl;
+
+    std::vector<uint64_t> keys(total);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(1));
+    const std::string value(VALUE_SIZE, 'v');
+
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(22) << "mutex put(Mops/s)" << std::setw(22)
+              << "mutex get(Mops/s)" << std::setw(22) << "cas put(Mops/s)" << std::setw(22) << "cas get(Mops/s)"
+              << std::endl;
+
+    for (int threads : {1, 2, 4, 8}) {
+        skiplist locked(0.5);
+        std::mutex lock;
+        double mutexPut = runThreads(threads, total, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                std::lock_guard<std::mutex> guard(lock);
+                locked.insert(keys[i], value);
+            }
+        });
+        double mutexGet = runThreads(threads, total, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (locked.search(keys[i]).size() != VALUE_SIZE)
+                    std::cerr << "Error: lost key " << keys[i] << std::endl;
+            }
+        });
+
+        concurrent_skiplist cas;
+        double casPut = runThreads(threads, total, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i)
+                cas.insert(keys[i], value);
+        });
+        double casGet = runThreads(threads, total, [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                if (cas.search(keys[i]).size() != VALUE_SIZE)
+                    std::cerr << "Error: lost key " << keys[i] << std::endl;
+            }
+        });
+
+        std::cout << std::left << std::fixed << std::setprecision(3) << std::setw(10) << threads << std::setw(22)
+                  << mutexPut << std::setw(22) << mutexGet << std::setw(22) << casPut << std::setw(22) << casGet
+                  << std::endl;
+    }
+
+    std::cout << std::endl << std::left << std::setw(10) << "entries" << std::setw(22) << "get latency(ns)" << std::endl;
+    for (uint64_t entries : {10000, 100000, 1000000}) {
+        skiplist list(0.5);
+        std::vector<uint64_t> order(entries);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(2));
+        for (uint64_t key : order)
+            list.insert(key, value);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(3));
+
+        const uint64_t lookups = std::max<uint64_t>(entries, 1000000);
+        uint64_t found         = 0;
+        auto start             = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < lookups; ++i)
+            found += list.search(order[i % entries]).size() == VALUE_SIZE;
+        auto end  = std::chrono::high_resolution_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / lookups;
+        if (found != lookups)
+            std::cerr << "Error: lost " << lookups - found << " keys" << std::endl;
+        std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(10) << entries << std::setw(22) << ns
+                  << std::endl;
+    }
+    return 0;
+}
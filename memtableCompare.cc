@@ -0,0 +1,135 @@
+#include "kvstore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 各种 memtable 在 timeCompare 的数据上的对比：
+ * 以 ./data/trimmed_text.txt 的文本行作为 value，顺序 put，再乱序 get 全部 key，最后做若干次短 scan。
+ * tableSize 设得足够大，让数据都留在 memtable 中，测到的是 memtable 本身的差别。
+ * 最后用 T 个线程同时 put（key 平均分给各个线程），比较 skiplist 和 concurrent 的写入吞吐随线程数的变化。
+ */
+
+std::vector<std::string> read_text(const std::string &filename) {
+    std::vector<std::string> lines;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() >= 30) // 与 timeCompare 一样跳过过短的行
+            lines.push_back(line);
+    }
+    if (lines.empty()) { // 没有文本文件时用长度相近的随机字符串代替
+        std::mt19937 rng(1);
+        for (int i = 0; i < 1000; ++i)
+            lines.emplace_back(30 + rng() % 300, 'a' + rng() % 26);
+    }
+    return lines;
+}
+
+template <class F>
+double elapsedMs(F &&work) {
+    auto start = std::chrono::high_resolution_clock::now();
+    work();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t total = 100000;
+    if (argc == 2)
+        total = std::stoull(argv[1]);
+
+    std::vector<std::string> text = read_text("./data/trimmed_text.txt");
+    std::cout << "Usage: " << argv[0] << " [number of keys]" << std::endl;
+    std::cout << "keys: " << total << ", text lines: " << text.size() << std::endl << std::endl;
+
+    std::vector<uint64_t> order(total);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(1));
+
+    std::cout << std::left << std::setw(16) << "memtable" << std::setw(14) << "put(ms)" << std::setw(14) << "get(ms)"
+              << std::setw(14) << "scan(ms)" << std::setw(16) << "memory(MB)" << std::endl;
+
+    const std::pair<MEMTABLE_TYPE, const char *> types[] = {
+        {MEMTABLE_SKIPLIST, "skiplist"},
+        {MEMTABLE_HASH_SKIPLIST, "hash_skiplist"},
+        {MEMTABLE_VECTOR, "vector"},
+        {MEMTABLE_CONCURRENT, "concurrent"}
+    };
+    for (auto [type, name] : types) {
+        Options options;
+        options.memtable  = type;
+        options.tableSize = 1024 * 1024 * 1024;
+        KVStore store("./data", options);
+        store.reset();
+
+        double put = elapsedMs([&] {
+            for (uint64_t i = 0; i < total; ++i)
+                store.put(i, text[i % text.size()]);
+        });
+
+        uint64_t lost = 0;
+        double get    = elapsedMs([&] {
+            for (uint64_t key : order)
+                lost += store.get(key) != text[key % text.size()];
+        });
+
+        double scan = elapsedMs([&] {
+            std::list<std::pair<uint64_t, std::string>> list;
+            for (int i = 0; i < 1000; ++i) {
+                list.clear();
+                store.scan(order[i], order[i] + 100, list);
+            }
+        });
+        if (lost)
+            std::cerr << "Error: " << name << " lost " << lost << " keys" << std::endl;
+
+        std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(16) << name << std::setw(14) << put
+                  << std::setw(14) << get << std::setw(14) << scan << std::setw(16)
+                  << store.memtableMemory() / 1024.0 / 1024.0 << std::endl;
+        store.reset();
+    }
+
+    std::cout << std::endl
+              << std::left << std::setw(10) << "threads" << std::setw(26) << "skiplist put(Kops/s)" << std::setw(26)
+              << "concurrent put(Kops/s)" << std::endl;
+    for (int threads : {1, 2, 4, 8}) {
+        std::cout << std::left << std::setw(10) << threads;
+        for (MEMTABLE_TYPE type : {MEMTABLE_SKIPLIST, MEMTABLE_CONCURRENT}) {
+            Options options;
+            options.memtable  = type;
+            options.tableSize = 1024 * 1024 * 1024;
+            KVStore store("./data", options);
+            store.reset();
+            double ms = elapsedMs([&] {
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t] {
+                        for (uint64_t i = total * t / threads; i < total * (t + 1) / threads; ++i)
+                            store.put(order[i], text[order[i] % text.size()]);
+                    });
+                }
+                for (auto &w : workers)
+                    w.join();
+            });
+            uint64_t lost = 0;
+            for (uint64_t key = 0; key < total; ++key)
+                lost += store.get(key) != text[key % text.size()];
+            if (lost)
+                std::cerr << "Error: " << threads << " threads lost " << lost << " keys" << std::endl;
+            std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(26) << total / ms;
+            store.reset();
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
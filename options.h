@@ -0,0 +1,62 @@
+#pragma once
+
+#include "block.h"
+#include "memtable.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * KVStore 的可选配置，构造时传入，默认值与原来的行为一致。
+ */
+struct Options {
+    // 每次提交写前日志后是否 fdatasync。
+    // false 时日志只写进操作系统缓存，进程崩溃不丢数据，掉电可能丢失最近的写入；
+    // true 时同一时刻排队的写请求合成一组，共用一次 fdatasync。
+    bool sync = false;
+
+    // 写完 sstable（flush 和 compaction 的输出）后是否 fdatasync 文件并 fsync 目录再让它生效。
+    // false 时依赖写前日志：flush 之后日志就被删除，掉电可能丢失刚落盘的 sstable。
+    bool syncTables = false;
+
+    // 每次从文件（或 mmap 映射）读出数据块时按块索引中的 crc32c 校验。不一致的块与读不出来的块一样是错误：
+    // 点查得到 READ_CORRUPTED（见 kvstore.h），不会去查更旧的数据；scan 停下；compaction 放弃这次合并，保留输入。
+    // 打开 sstable 时总会校验文件头、bloom 和块索引；块缓存命中时不再重复校验。老格式的 sstable 没有校验和，不校验。
+    bool verifyChecksums = false;
+
+    // sstable 数据块的压缩方式（内置的 lz，见 lz.h），压缩后小不了 1/8 的块仍然原样存放。
+    // 块缓存中放的是解压后的块，命中时不用再解压；mmapReads 打开时没有块缓存，压缩过的块每次读都要解压。
+    // memtable 按解压后的大小切换，flush 写出的 sstable 会比 tableSize 小。
+    // 解压失败的块是错误，不论 verifyChecksums 是否打开，都与校验不一致的块一样处理，compaction 不会越过它。
+    COMPRESSION_TYPE compression = COMPRESSION_NONE;
+
+    // compression 不是 COMPRESSION_NONE 时，compaction 写入这一层及更深的层改用 COMPRESSION_HIGH：
+    // 冷数据很少再被改写，多花些写入时的 CPU 换更小的文件，读的时候解压一样快。设成很大的数则始终用 compression。
+    int coldLevel = 2;
+
+    // del 不再为了返回值去查 sstable：只查内存中的 memtable，
+    // 找到墓碑时返回 false，其余情况直接写墓碑并返回 true（key 可能本来就不存在）。
+    bool blindDelete = false;
+
+    // sstable 文件大小的目标值（字节，包括文件头和 bloom filter）。
+    // memtable 落盘后的大小将超过它时切换 memtable，compaction 也按它切分输出的 sstable。
+    uint32_t tableSize = 2 * 1024 * 1024;
+
+    // memtable 的实现，见 memtable.h
+    MEMTABLE_TYPE memtable = MEMTABLE_SKIPLIST;
+
+    // 最多同时保持打开的 sstable 文件数，读取时复用，不再每次 open/close
+    int maxOpenFiles = 256;
+
+    // 打开 sstable 时整个文件 mmap 进来，get/scan/compaction 直接从映射中取 value，
+    // 读取变成内存访问；文件被删除或被挤出 table cache 时解除映射。适合读多、数据能放进 page cache 的场景。
+    bool mmapReads = false;
+
+    // sstable 数据块缓存的大小（字节），0 表示不缓存。
+    // 热点 key 所在的块留在内存中，get/scan 命中时不用再读文件；mmapReads 打开时块已经在映射里，不经过这个缓存。
+    size_t blockCacheSize = 8 * 1024 * 1024;
+
+    // getAsync 用 io_uring 提交读请求，一个线程就能让几十个读同时在途；
+    // false 或内核不支持 io_uring 时改用线程池中的 pread。
+    bool useIoUring = true;
+};
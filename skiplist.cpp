@@ -4,45 +4,85 @@
 
 #include "skiplist.h"
 
-double skiplist::my_rand() {
-    return (double)rand() / RAND_MAX;
+#include <cstring>
+
+/*
+ * 节点、塔和 value 一次性从 arena 中分配：
+ * [slnode | nxt[1..level-1] | value bytes]
+ */
+slnode *skiplist::newNode(uint64_t key, const std::string &val, TYPE type, int level) {
+    size_t towerSize = sizeof(slnode) + sizeof(slnode *) * (level - 1);
+    char *buf        = mem.allocateAligned(towerSize + val.size(), sizeof(slnode));
+    auto *node       = reinterpret_cast<slnode *>(buf);
+    node->key        = key;
+    node->type       = type;
+    node->len        = val.size();
+    node->val        = buf + towerSize;
+    std::memcpy(buf + towerSize, val.data(), val.size());
+    for (int i = 0; i < level; ++i)
+        node->nxt[i] = nullptr;
+    return node;
 }
 
-int skiplist::randLevel() {
-    int level = 1;
-    while (my_rand() < p && level < MAX_LEVEL) {
-        level++;
+void skiplist::init() {
+    head = newNode(0, "", HEAD, MAX_LEVEL);
+    tail = newNode(INF, "", TAIL, MAX_LEVEL); // 每一层都可以读 tail->nxt，预取时不需要判断
+    for (int i = 0; i < MAX_LEVEL; ++i)
+        head->nxt[i] = tail;
+}
+
+/*
+ * 比较 next->key 的同时预取 next 在这一层的后继，
+ * 向右走一步时下一个节点的 cache line 大概率已经在路上。
+ */
+slnode *skiplist::findGreaterOrEqual(uint64_t key, slnode **update) {
+    slnode *x = head;
+    for (int level = curMaxL - 1; level >= 0; --level) {
+        slnode *next = x->nxt[level];
+        while (true) {
+            __builtin_prefetch(next->nxt[level]);
+            if (next->key >= key) // tail 的 key 为 INF，一定会停下
+                break;
+            x    = next;
+            next = x->nxt[level];
+        }
+        if (update)
+            update[level] = x;
     }
-    return level;
+    return x->nxt[0];
+}
+
+int skiplist::randLevel() {
+    return rng.level(bitsPerLevel, MAX_LEVEL);
 }
 
 void skiplist::insert(uint64_t key, const std::string &str) {
-    slnode *x = head;
-    slnode *update[MAX_LEVEL];
+    upsert(key, str);
+}
 
-    // **手动初始化 update 数组**
-    for (int i = 0; i < MAX_LEVEL; ++i) {
-        update[i] = nullptr;
-    }
+/*
+ * 只查找一次：key 已存在时替换 value，否则在同一次查找得到的前驱之后链接新节点。
+ * 返回 bytes 的变化量，调用者不需要先 search 一遍再拷贝旧 value 来计算大小。
+ */
+int64_t skiplist::upsert(uint64_t key, const std::string &str) {
+    slnode *node;
+    return upsert(key, str, &node);
+}
+
+int64_t skiplist::upsert(uint64_t key, const std::string &str, slnode **node) {
+    slnode *update[MAX_LEVEL];
 
     // **寻找插入位置，并填充 update 数组**
-    for (int level = curMaxL - 1; level >= 0; --level) {
-        while (x->nxt[level] && x->nxt[level]->key < key) {
-            x = x->nxt[level];
-        }
-        update[level] = x;  // **存储当前层的前驱节点**
-    }
+    slnode *x = findGreaterOrEqual(key, update);
 
     // **检查 key 是否已存在**
-    x = x->nxt[0];
-    if (x && x->key == key) {
-        x->val = str; // **更新已存在 key 的值**
-        return;
+    if (x->type == NORMAL && x->key == key) {
+        *node = x;
+        return replaceValue(x, str);
     }
 
-    // **生成新节点的层数**
+    // **生成新节点的层数，不超过 MAX_LEVEL**
     int newLevel = randLevel();
-    newLevel = std::min(newLevel, MAX_LEVEL);  // 确保不超过 MAX_LEVEL
 
     // **如果新层数大于当前最大层，初始化 update**
     if (newLevel > curMaxL) {
@@ -53,45 +93,46 @@ void skiplist::insert(uint64_t key, const std::string &str) {
     }
 
     // **创建新节点**
-    auto *newNode = new slnode(key, str, NORMAL);
+    x = newNode(key, str, NORMAL, newLevel);
 
     // **插入新节点**
     for (int i = 0; i < newLevel; ++i) {
-        newNode->nxt[i] = update[i]->nxt[i];  // **链接后继节点**
-        update[i]->nxt[i] = newNode;  // **前驱节点指向新节点**
+        x->nxt[i] = update[i]->nxt[i];  // **链接后继节点**
+        update[i]->nxt[i] = x;  // **前驱节点指向新节点**
     }
 
     // **更新跳表的总字节数**
-    bytes += sizeof(slnode) + str.size();
+    *node = x;
+    bytes += 12 + str.size(); // 一个索引项 (key, offset) 加上 value
+    return 12 + str.size();
 }
 
-std::string skiplist::search(uint64_t key) {
-    slnode *x = head;
-    for (int i = curMaxL - 1; i >= 0; --i) {
-        while (x->nxt[i] && x->nxt[i]->key < key) {
-            x = x->nxt[i];
-        }
-    }
-    x = x->nxt[0];
-    if (x && x->key == key) {
-        return x->val;
+int64_t skiplist::replaceValue(slnode *node, const std::string &str) {
+    // **旧 value 留在 arena 中不再引用**
+    char *val = mem.allocate(str.size());
+    std::memcpy(val, str.data(), str.size());
+    int64_t delta = (int64_t)str.size() - node->len;
+    node->val     = val;
+    node->len     = str.size();
+    bytes += delta;
+    return delta;
+}
+
+bool skiplist::find(uint64_t key, const char *&val, uint32_t &len) {
+    slnode *x = findGreaterOrEqual(key, nullptr);
+    if (x->type == NORMAL && x->key == key) {
+        val = x->val;
+        len = x->len;
+        return true;
     }
-    return "";
+    return false;
 }
 
-bool skiplist::del(uint64_t key, uint32_t len) {
+bool skiplist::del(uint64_t key) {
     slnode *update[MAX_LEVEL];
-    slnode *x = head;
-
-    for (int i = curMaxL - 1; i >= 0; --i) {
-        while (x->nxt[i] && x->nxt[i]->key < key) {
-            x = x->nxt[i];
-        }
-        update[i] = x;
-    }
-    x = x->nxt[0];
+    slnode *x = findGreaterOrEqual(key, update);
 
-    if (!x || x->key != key) {
+    if (x->type != NORMAL || x->key != key) {
         return false;
     }
 
@@ -100,8 +141,7 @@ bool skiplist::del(uint64_t key, uint32_t len) {
         update[i]->nxt[i] = x->nxt[i];
     }
 
-    delete x;
-    bytes -= len;
+    bytes -= 12 + x->len; // 节点内存随 arena 一起释放
 
     while (curMaxL > 1 && head->nxt[curMaxL - 1] == tail) {
         curMaxL--;
@@ -111,42 +151,58 @@ bool skiplist::del(uint64_t key, uint32_t len) {
 
 void skiplist::scan(uint64_t key1, uint64_t key2,
                     std::vector<std::pair<uint64_t, std::string>> &list) {
-    slnode *x = head;
-    for (int i = curMaxL - 1; i >= 0; --i) {
-        while (x->nxt[i] && x->nxt[i]->key < key1) {
-            x = x->nxt[i];
-        }
-    }
-    x = x->nxt[0];
+    slnode *x = findGreaterOrEqual(key1, nullptr);
 
     while (x && x->key <= key2) {
         if (x->type == NORMAL) {
-            list.emplace_back(x->key, x->val);
+            list.emplace_back(x->key, x->value());
         }
         x = x->nxt[0];
     }
 }
 
-slnode *skiplist::lowerBound(uint64_t key) {
-    slnode *x = head;
-    for (int i = curMaxL - 1; i >= 0; --i) {
-        while (x->nxt[i] && x->nxt[i]->key < key) {
-            x = x->nxt[i];
-        }
+namespace {
+class skiplist_iter : public memiter {
+private:
+    slnode *cur;
+
+public:
+    explicit skiplist_iter(slnode *first) : cur(first) {}
+
+    bool valid() override {
+        return cur->type != TAIL;
     }
-    return x->nxt[0];
-}
 
-void skiplist::reset() {
-    slnode *x = head->nxt[0];
-    while (x != tail) {
-        slnode *next = x->nxt[0];
-        delete x;
-        x = next;
+    void next() override {
+        cur = cur->nxt[0];
     }
-    for (int i = 0; i < MAX_LEVEL; ++i) {
-        head->nxt[i] = tail;
+
+    uint64_t key() override {
+        return cur->key;
+    }
+
+    const char *val() override {
+        return cur->val;
     }
+
+    uint32_t len() override {
+        return cur->len;
+    }
+};
+} // namespace
+
+std::unique_ptr<memiter> skiplist::begin() {
+    return std::make_unique<skiplist_iter>(head->nxt[0]);
+}
+
+slnode *skiplist::lowerBound(uint64_t key) {
+    return findGreaterOrEqual(key, nullptr);
+}
+
+void skiplist::reset() {
+    mem.reset(); // 整个 arena 一次释放，不再逐个 delete 节点
+    rng = fastrand(seed);
+    init();
     curMaxL = 1;
     bytes = 0;
 }
@@ -154,3 +210,7 @@ void skiplist::reset() {
 uint32_t skiplist::getBytes() {
     return this->bytes;
 }
+
+size_t skiplist::memoryUsage() {
+    return mem.memoryUsage();
+}
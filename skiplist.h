@@ -1,6 +1,12 @@
 #ifndef LSM_KV_SKIPLIST_H
 #define LSM_KV_SKIPLIST_H
 
+#include "arena.h"
+#include "fastrand.h"
+#include "memtable.h"
+
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <list>
@@ -15,55 +21,70 @@ enum TYPE {
 
 const int MAX_LEVEL = 18;
 
+// 查找时只读 key 和 nxt，节点分配时保证 key 到 nxt[0] 落在同一个 cache line 内
 class slnode {
 public:
     uint64_t key;
-    std::string val;
+    const char *val; // value 存放在 arena 中，节点只保存指针和长度
+    uint32_t len;
     TYPE type;
-    std::vector<slnode *> nxt;
+    slnode *nxt[1]; // 实际长度为节点的层数，随节点一起在 arena 中分配
 
-    slnode(uint64_t key, const std::string &val, TYPE type) {
-        this->key  = key;
-        this->val  = val;
-        this->type = type;
-        for (int i = 0; i < MAX_LEVEL; ++i)
-            nxt.push_back(nullptr);
+    std::string value() const {
+        return std::string(val, len);
     }
 };
 
-class skiplist {
+class skiplist : public memtable {
 private:
     const uint64_t INF = std::numeric_limits<uint64_t>::max();
     double p;
+    int bitsPerLevel; // p 取最接近的 2^-bitsPerLevel
+    uint64_t seed;
+    fastrand rng;
     uint64_t s     = 1;
-    uint32_t bytes = 0x0; // bytes表示index + data区域的字节数
+    uint32_t bytes = 0x0; // bytes表示写成sstable后index + data区域的字节数，每个key占12 + value长度
     int curMaxL    = 1;
-    slnode *head   = new slnode(0, "", HEAD);
-    slnode *tail   = new slnode(INF, "", TAIL);
+    arena mem;            // 所有节点和 value 的内存
+    slnode *head   = nullptr;
+    slnode *tail   = nullptr;
+
+    slnode *newNode(uint64_t key, const std::string &val, TYPE type, int level);
+    void init();
+    // 返回第一个 key >= 参数的节点，update 不为空时记录每一层的前驱
+    slnode *findGreaterOrEqual(uint64_t key, slnode **update);
 
 public:
-    skiplist(double p) { // p 表示增长概率
+    // p 表示增长概率，seed 为层数生成器的种子，同样的种子和插入顺序得到同样形状的跳表
+    skiplist(double p, uint64_t seed = 0) : seed(seed), rng(seed) {
         s       = 1;
         bytes   = 0x0;
         curMaxL = 1;
         this->p = p;
-        for (int i = 0; i < MAX_LEVEL; ++i)
-            head->nxt[i] = tail;
+        bitsPerLevel = std::max(1, (int)std::lround(-std::log2(p)));
+        init();
     }
 
+    skiplist(const skiplist &) = delete;
+    skiplist &operator=(const skiplist &) = delete;
+
     slnode *getFirst() {
         return head->nxt[0];
     }
 
-    double my_rand();
     int randLevel();
     void insert(uint64_t key, const std::string &str);
-    std::string search(uint64_t key);
-    bool del(uint64_t key, uint32_t len);
-    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list);
+    int64_t upsert(uint64_t key, const std::string &str) override; // 插入或更新，返回 bytes 的变化量
+    int64_t upsert(uint64_t key, const std::string &str, slnode **node); // 同上，node 返回 key 所在的节点
+    int64_t replaceValue(slnode *node, const std::string &str);        // 替换已有节点的 value
+    bool find(uint64_t key, const char *&val, uint32_t &len) override;
+    bool del(uint64_t key);
+    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) override;
+    std::unique_ptr<memiter> begin() override;
     slnode *lowerBound(uint64_t key);
-    void reset();
-    uint32_t getBytes();
+    void reset() override;
+    uint32_t getBytes() override;  // 落盘后的大小（不含文件头和 bloom filter）
+    size_t memoryUsage() override; // arena 实际占用的内存，包括节点、塔和被覆盖的旧 value
 };
 
 #endif // LSM_KV_SKIPLIST_H
@@ -1,105 +1,93 @@
 #include "sstable.h"
 
+#include "block.h"
+
+#include "crc32c.h"
 #include "sstablehead.h"
+#include "tablebuilder.h"
 #include "utils.h"
 
+#include <cstdio>
 #include <iostream>
 const uint32_t MAXSIZE = 2 * 1024 * 1024; // 2MB
 
 /*
  *  在path路径下创建一个新的sstable，时间戳为缓存sstable的时间戳
+ *  写出的是 TABLE_BLOCK 格式，写完后 blocks 和 bytes 对应磁盘上的文件
+ *  整个文件先在内存中拼好，再用一次 write 写出；sync 为真时 fdatasync 之后才改名
+ *  compression 不是 COMPRESSION_NONE 时数据块压缩后写出
  * */
-void sstable::putFile(const char *path) { // 将内存中的输出到二进制文件中
-    // std::cout << "output path" << path << std::endl;
-    FILE *file = fopen(path, "wb");
-    fseek(file, 0, SEEK_SET);
-    // 4个u64变量
-    fwrite(&time, 8, 1, file);
-    fwrite(&cnt, 8, 1, file);
-    fwrite(&minV, 8, 1, file);
-    fwrite(&maxV, 8, 1, file);
-    for (int i = 0; i < 8 * M; i += 8) { // bloom
-        unsigned char cur = 0x0;
-        for (int j = 0; j < 8; ++j)
-            cur |= (filter.getBit(i + j) << j);
-        fwrite(&cur, 1, 1, file);
-    }
-    int size = index.size();
-    for (int i = 0; i < size; ++i) { // index
-        uint64_t key    = index[i].key;
-        uint32_t offset = index[i].offset;
-        fwrite(&key, 8, 1, file);
-        fwrite(&offset, 4, 1, file);
-    }
-    size = data.size();
+bool sstable::putFile(const char *path, bool sync, COMPRESSION_TYPE compression) { // 将内存中的输出到二进制文件中
+    // 条目、restart 数组、bloom、块索引和 footer 的大致大小，写缓冲不会在 finish 之前满
+    size_t expected = bytes + bytes / (4 * RESTART_INTERVAL) + (bytes / BLOCK_SIZE + 1) * BLOCK_ENTRY + FOOTER_SIZE;
+    tablebuilder builder(path, time, sync, compression, expected);
+    int size = data.size();
     for (int i = 0; i < size; ++i) { // datas
-        fwrite(data[i].data(), 1, data[i].length(), file);
+        if (!builder.add(index[i].key, data[i].data(), data[i].length()))
+            return false;
     }
-    fflush(file); // 清空缓冲区
-    fclose(file);
+    if (!builder.finish())
+        return false;
+    blocks     = builder.getBlocks();
+    bytes      = builder.fileSize();
+    format     = TABLE_BLOCK;
+    hashed     = true;
+    compressed = compression != COMPRESSION_NONE;
+    return true;
 }
 
-char buf[2097152];
-
-void sstable::loadFile(const char *path) { // load file from the path
-    filename = path;
-    int len = std::strlen(path), c = 0;
-    std::string suf;
-    for (int i = 0; i < len; ++i) {
-        if (c == 2)
-            suf += path[i];
-        if (path[i] == '-') {
-            c++;
-        }
-        if (path[i] == '.')
-            c = 0;
-    }
-    if (suf.size())
-        nameSuffix = std::stoi(suf);
-    else
-        nameSuffix = 0;
-    FILE *file = fopen(path, "rb+");
-    fseek(file, 0, SEEK_SET); // 移动到开头
+bool sstable::loadFile(const char *path) { // load file from the path
     reset();
-    fread(&time, 8, 1, file);
-    fread(&cnt, 8, 1, file);
-    fread(&minV, 8, 1, file);
-    fread(&maxV, 8, 1, file);
-    for (int i = 0; i < 8 * M; i += 8) { // bloom
-        unsigned char cur = 0x0;
-        fread(&cur, 1, 1, file);
-        for (int j = 0; j < 8; ++j) {
-            if ((cur >> j) & 1)
-                filter.setBit(i + j);
-        }
+    if (!loadFileHead(path)) { // 同时检查了 bloom 和索引
+        std::cerr << "Error: Corrupted sstable " << path << std::endl;
+        return false;
     }
-    bytes = 10240 + 32 + 12 * cnt;
-    Index temp;
-    for (int i = 0; i < cnt; ++i) { // index
-        fread(&temp.key, 8, 1, file);
-        fread(&temp.offset, 4, 1, file);
-        index.push_back(temp);
-    }
-    bytes += temp.offset;
-    std::string cur; // data
-    fread(buf, 1, index[0].offset, file);
-    buf[index[0].offset] = '\0';
-    cur                  = buf;
-    data.push_back(cur);
-    for (int i = 1; i < cnt; ++i) {
-        fread(buf, 1, index[i].offset - index[i - 1].offset, file);
-        buf[index[i].offset - index[i - 1].offset] = '\0';
-        cur                                        = buf;
-        data.push_back(cur);
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    bool ok = true;
+    if (format == TABLE_BLOCK) { // 逐块解析
+        for (int i = 0; ok && i < blocks.size(); ++i) {
+            BlockIndex b = blocks.get(i);
+            auto block   = std::make_shared<std::string>(b.size, '\0');
+            fseek(file, b.offset, SEEK_SET);
+            ok = fread(block->data(), 1, b.size, file) == b.size;
+            if (ok && hasChecksums() && crc32c::value(block->data(), b.size) != b.crc) {
+                std::cerr << "Error: Checksum mismatch in block " << i << " of " << path << std::endl;
+                ok = false;
+            }
+            if (ok && compressed && !uncompressBlock(*block)) {
+                std::cerr << "Error: Corrupted block " << i << " of " << path << std::endl;
+                ok = false;
+            }
+            blockiter it(block);
+            for (it.seekToFirst(); ok && it.valid(); it.next()) {
+                curpos += it.valueLen();
+                index.emplace_back(it.key(), curpos);
+                data.push_back(it.value());
+            }
+        }
+        ok = ok && index.size() == cnt;
+    } else {
+        fseek(file, 10240 + 32 + 12 * cnt, SEEK_SET);
+        uint32_t last = 0; // data，直接读进每个 value 自己的 string
+        for (uint64_t i = 0; ok && i < cnt; ++i) {
+            std::string cur(index[i].offset - last, '\0');
+            ok = fread(cur.data(), 1, cur.size(), file) == cur.size();
+            data.push_back(std::move(cur));
+            last = index[i].offset;
+        }
     }
-    fflush(file);
     fclose(file);
+    if (!ok) {
+        std::cerr << "Error: Corrupted sstable " << path << std::endl;
+        reset();
+    }
+    return ok;
 }
 
 bloom sstable::copyFilter() {
-    bloom *res = new bloom;
-    res->setBitset(filter.getBitset());
-    return *res;
+    return filter;
 }
 
 std::vector<Index> sstable::copyIndexs() {
@@ -108,17 +96,23 @@ std::vector<Index> sstable::copyIndexs() {
 }
 
 sstablehead sstable::getHead() {
-    auto *res = new sstablehead;
-    res->setFilename(filename);
-    res->setNamesuffix(nameSuffix);
-    res->setTime(time);
-    res->setCnt(cnt);
-    res->setMinV(minV);
-    res->setMaxV(maxV);
-    res->setBytes(bytes);
-    res->setFilter(filter);
-    res->setIndex(index);
-    return *res;
+    sstablehead res;
+    res.setFilename(filename);
+    res.setNamesuffix(nameSuffix);
+    res.setTime(time);
+    res.setCnt(cnt);
+    res.setMinV(minV);
+    res.setMaxV(maxV);
+    res.setBytes(bytes);
+    res.setFilter(filter);
+    if (format == TABLE_BLOCK) {
+        res.setBlocks(blocks); // 写出之后只需要块索引
+        res.setHashed(hashed);
+        res.setCompressed(compressed);
+    } else {
+        res.setIndex(index);
+    }
+    return res;
 }
 
 // 向sstable尾部插一个key-val对，同时修改头和bloom filter
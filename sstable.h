@@ -3,7 +3,7 @@
 #ifndef LSM_KV_SSTABLE_H
 #define LSM_KV_SSTABLE_H
 #include "bloom.h"
-#include "skiplist.h"
+#include "memtable.h"
 #include "sstablehead.h"
 
 #include <cstdint>
@@ -26,6 +26,8 @@ public:
         filter.reset();
         index.clear();
         data.clear();
+        blocks.clear();
+        format = TABLE_FLAT;
     }
 
     sstable() {
@@ -40,32 +42,32 @@ public:
         data.clear();
     }
 
-    sstable(skiplist *s) { // 将一个memtable转成sstable， 这里时间戳加1
+    sstable(memtable *s) { // 将一个memtable转成sstable， 这里时间戳加1
         reset();
-        curpos      = 0;
-        bytes       = 10240 + 32 + s->getBytes();
-        time        = ++TIME;
-        filename    = "./data/level-0/" + std::to_string(TIME) + ".sst"; // 初始的文件名就是时间戳
-        cnt         = 0;
-        minV        = INF;
-        maxV        = 0;
-        slnode *cur = s->getFirst();
-        while (cur->type != TAIL) { // curpos 为这个串的终止地址
+        auto cur = s->begin(); // 先取迭代器，vector memtable 会在这里排序去重，之后 getBytes 才准确
+        curpos   = 0;
+        bytes    = 10240 + 32 + s->getBytes();
+        time     = ++TIME;
+        filename = "./data/level-0/" + std::to_string(TIME) + ".sst"; // 初始的文件名就是时间戳
+        cnt      = 0;
+        minV     = INF;
+        maxV     = 0;
+        for (; cur->valid(); cur->next()) { // curpos 为这个串的终止地址
             cnt++;
-            curpos += cur->val.length();
-            minV = std::min(minV, cur->key);
-            maxV = std::max(maxV, cur->key);
-            filter.insert(cur->key);
-            index.emplace_back(cur->key, curpos);
-            data.push_back(cur->val);
-            cur = cur->nxt[0];
+            curpos += cur->len();
+            minV = std::min(minV, cur->key());
+            maxV = std::max(maxV, cur->key());
+            filter.insert(cur->key());
+            index.emplace_back(cur->key(), curpos);
+            data.push_back(cur->value());
         }
     }
 
     bool checkSize(std::string val, int curLevel,
                    int flag);        // 检查大小，如果不够加val, 创新sstable
-    void putFile(const char *path);  //  将sstable输出到路径
-    void loadFile(const char *path); // 从路径载入一个sstable
+    // 将sstable输出到路径，失败时返回 false 且不留下文件
+    bool putFile(const char *path, bool sync = false, COMPRESSION_TYPE compression = COMPRESSION_NONE);
+    bool loadFile(const char *path); // 从路径载入一个sstable，文件损坏时返回 false
 
     void insert(uint64_t key, const std::string &val);
 
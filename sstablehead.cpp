@@ -1,10 +1,18 @@
 #include "sstablehead.h"
 
+#include "crc32c.h"
+#include "levelfilter.h"
+
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
-void sstablehead::loadFileHead(const char *path) { // 只读取文件头
-    FILE *file = fopen(path, "rb+");               // 注意格式为二进制
+/*
+ * 读入 sstable 的 bloom 和索引，文件打不开、格式不对或校验和不符时返回 false。
+ * 旧格式没有校验和，只检查索引是否递增、大小是否与文件相符。
+ */
+bool sstablehead::loadFileHead(const char *path) { // 只读取文件头
+    FILE *file = fopen(path, "rb");                // 注意格式为二进制
     filename   = path;
     int len = std::strlen(path), c = 0;
     std::string suf;
@@ -21,39 +29,158 @@ void sstablehead::loadFileHead(const char *path) { // 只读取文件头
         nameSuffix = std::stoi(suf);
     else
         nameSuffix = 0;
-    fseek(file, 0, SEEK_SET);
     reset();
-
-    fread(&time, 8, 1, file);
-    fread(&cnt, 8, 1, file);
-    fread(&minV, 8, 1, file);
-    fread(&maxV, 8, 1, file);
-    for (int i = 0; i < M * 8; i += 8) { // bloom
-        unsigned char cur = 0x0;
-        fread(&cur, 1, 1, file);
-        for (int j = 0; j < 8; ++j) {
-            if ((cur >> j) & 1)
-                filter.setBit(i + j);
-        }
+    if (!file)
+        return false;
+    if (loadFooter(file)) {
+        fclose(file);
+        return true;
     }
-    Index temp;
+    fseek(file, 0, SEEK_END);
+    uint64_t size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = size >= 10240 + 32 && fread(&time, 8, 1, file) == 1;
+    ok      = ok && fread(&cnt, 8, 1, file) == 1;
+    ok      = ok && fread(&minV, 8, 1, file) == 1;
+    ok      = ok && fread(&maxV, 8, 1, file) == 1;
+    ok      = ok && fread(filter.data(), 1, M, file) == M; // bloom
+    ok      = ok && cnt <= (size - 10240 - 32) / 12;
+    Index temp(0, 0);
     bytes = 10240 + 32 + 12 * cnt;
-    for (int i = 0; i < cnt; ++i) { // index
-        fread(&temp.key, 8, 1, file);
-        fread(&temp.offset, 4, 1, file);
+    for (uint64_t i = 0; ok && i < cnt; ++i) { // index
+        uint32_t last = temp.offset;
+        uint64_t key  = temp.key;
+        ok            = fread(&temp.key, 8, 1, file) == 1 && fread(&temp.offset, 4, 1, file) == 1;
+        ok            = ok && temp.offset >= last && (i == 0 || temp.key > key);
         index.push_back(temp);
     }
     bytes += temp.offset;
-    fflush(file);
     fclose(file);
+    if (!ok || bytes != size) {
+        reset();
+        time = cnt = maxV = 0;
+        minV           = std::numeric_limits<uint64_t>::max();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 文件末尾是合法的 footer 时按 TABLE_BLOCK 读入 bloom 和块索引，返回 true；
+ * 否则是旧格式或者已经损坏，返回 false。带校验和的文件在这里检查 bloom、块索引和 footer 的 crc32c。
+ */
+bool sstablehead::loadFooter(FILE *file) {
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size < (long)FOOTER_SIZE)
+        return false;
+    char footer[FOOTER_SIZE];
+    uint32_t filterOffset, indexOffset, count, flags;
+    uint64_t magic;
+    fseek(file, size - FOOTER_SIZE, SEEK_SET);
+    if (fread(footer, 1, FOOTER_SIZE, file) != FOOTER_SIZE)
+        return false;
+    std::memcpy(&time, footer, 8);
+    std::memcpy(&cnt, footer + 8, 8);
+    std::memcpy(&minV, footer + 16, 8);
+    std::memcpy(&maxV, footer + 24, 8);
+    std::memcpy(&filterOffset, footer + 32, 4);
+    std::memcpy(&indexOffset, footer + 36, 4);
+    std::memcpy(&count, footer + 40, 4);
+    std::memcpy(&flags, footer + 44, 4);
+    std::memcpy(&magic, footer + 48, 8);
+    // 除了 magic 还要求各部分首尾相接、块索引能解码，旧格式的 value 恰好以 magic 结尾也不会认错
+    uint32_t known    = TABLE_HASHES | TABLE_INDEX_DELTA | TABLE_CHECKSUM | TABLE_COMPRESSED;
+    uint64_t indexEnd = size - FOOTER_SIZE - (flags & TABLE_CHECKSUM ? 4 : 0);
+    bool ok           = magic == TABLE_MAGIC && (flags & ~known) == 0 && (uint64_t)filterOffset + M == indexOffset &&
+              indexOffset <= indexEnd;
+    if (ok && (flags & TABLE_HASHES))
+        ok = cnt <= filterOffset / 4 && filterOffset - cnt * 4 >= (flags & TABLE_CHECKSUM ? 4u : 0u);
+    if (ok && !(flags & TABLE_INDEX_DELTA))
+        ok = (uint64_t)indexOffset + (uint64_t)count * BLOCK_ENTRY == indexEnd;
+    std::string meta; // bloom、块索引和校验和，一次读入
+    if (ok) {
+        meta.resize(size - FOOTER_SIZE - filterOffset);
+        fseek(file, filterOffset, SEEK_SET);
+        ok = fread(meta.data(), 1, meta.size(), file) == meta.size();
+    }
+    if (ok && (flags & TABLE_CHECKSUM)) {
+        uint32_t expected, actual = crc32c::value(meta.data(), meta.size() - 4);
+        std::memcpy(&expected, meta.data() + meta.size() - 4, 4);
+        actual = crc32c::extend(actual, footer, FOOTER_SIZE);
+        ok     = actual == expected;
+    }
+    if (ok) {
+        const char *index = meta.data() + M;
+        if (flags & TABLE_INDEX_DELTA) {
+            ok = blocks.decodeFrom(index, indexEnd - indexOffset, count, flags & TABLE_CHECKSUM);
+        } else {
+            for (uint32_t i = 0; ok && i < count; ++i) { // 定长的旧块索引，转成新的编码
+                BlockIndex b;
+                std::memcpy(&b.lastKey, index + i * BLOCK_ENTRY, 8);
+                std::memcpy(&b.offset, index + i * BLOCK_ENTRY + 8, 4);
+                std::memcpy(&b.size, index + i * BLOCK_ENTRY + 12, 4);
+                ok = blocks.add(b);
+            }
+        }
+    }
+    if (!ok) {
+        blocks.clear();
+        time = cnt = maxV = 0;
+        minV           = std::numeric_limits<uint64_t>::max();
+        return false;
+    }
+
+    std::memcpy(filter.data(), meta.data(), M); // bloom
+    format     = TABLE_BLOCK;
+    hashed     = flags & TABLE_HASHES;
+    compressed = flags & TABLE_COMPRESSED;
+    bytes      = size;
+    return true;
 }
 
 void sstablehead::reset() {
     filter.reset();
     index.clear();
+    blocks.clear();
+    format     = TABLE_FLAT;
+    hashed     = false;
+    compressed = false;
 }
 
-int sstablehead::search(uint64_t key) {
+bool sstablehead::loadHashes(std::vector<uint32_t> &hashes) const {
+    hashes.clear();
+    if (format == TABLE_FLAT) { // 索引就在内存中
+        hashes.reserve(index.size());
+        for (const Index &i : index)
+            hashes.push_back(levelfilter::hash(i.key));
+        return true;
+    }
+    if (!hashed)
+        return false;
+    FILE *file = fopen(filename.data(), "rb");
+    if (!file)
+        return false;
+    // 哈希紧挨在 bloom 之前，带校验和时后面还有它们的 crc32c，bloom 的偏移在 footer 中
+    uint32_t filterOffset = 0, expected = 0, crcLen = hasChecksums() ? 4 : 0;
+    bool ok = fseek(file, -(long)FOOTER_SIZE + 32, SEEK_END) == 0 && fread(&filterOffset, 4, 1, file) == 1;
+    ok      = ok && fseek(file, filterOffset - crcLen - cnt * 4, SEEK_SET) == 0;
+    if (ok) {
+        hashes.resize(cnt);
+        ok = fread(hashes.data(), 4, cnt, file) == cnt && fread(&expected, crcLen, 1, file) == (crcLen ? 1 : 0);
+    }
+    fclose(file);
+    if (ok && crcLen && crc32c::value(reinterpret_cast<const char *>(hashes.data()), cnt * 4) != expected) {
+        std::cerr << "Error: Checksum mismatch in key hashes of " << filename << std::endl;
+        ok = false;
+    }
+    if (!ok)
+        hashes.clear();
+    return ok;
+}
+
+int sstablehead::search(uint64_t key) const {
     int res = filter.search(key);
     if (!res)
         return -1; // bloom 说没有 确实没有
@@ -65,7 +192,7 @@ int sstablehead::search(uint64_t key) {
     return -1;
 }
 
-int sstablehead::searchOffset(uint64_t key, uint32_t &len) {
+int sstablehead::searchOffset(uint64_t key, uint32_t &len) const {
     int res = filter.search(key);
     if (!res)
         return -1; // bloom 说没有 确实没有
@@ -84,7 +211,18 @@ int sstablehead::searchOffset(uint64_t key, uint32_t &len) {
     return -1;
 }
 
-int sstablehead::lowerBound(uint64_t key) {
+int sstablehead::lowerBound(uint64_t key) const {
     auto it = std::lower_bound(index.begin(), index.end(), Index(key, 0));
     return it - index.begin(); // found
 }
+
+int sstablehead::findBlock(uint64_t key) const {
+    if (!filter.search(key))
+        return -1;
+    int p = seekBlock(key);
+    return p < (int)blocks.size() ? p : -1;
+}
+
+int sstablehead::seekBlock(uint64_t key) const {
+    return blocks.seek(key);
+}
@@ -2,12 +2,44 @@
 
 #ifndef LSM_KV_SSTABLEHEAD_H
 #define LSM_KV_SSTABLEHEAD_H
+#include "block.h"
 #include "bloom.h"
 
 #include <cstdint>
+#include <cstdio>
+#include <string>
 #include <vector>
 #include <limits>
 
+/*
+ * sstable 有两种文件格式：
+ *   TABLE_FLAT  旧格式，[32 字节头][10240 字节 bloom][每个 key 12 字节的索引][data]，
+ *               载入时整个索引读进内存；只读，compaction 时改写成新格式。
+ *   TABLE_BLOCK [数据块]...[bloom][块索引][u32 crc32c][footer]，数据块和块索引的格式见 block.h。
+ *               footer = [u64 time][u64 cnt][u64 minV][u64 maxV]
+ *                        [u32 bloom 偏移][u32 块索引偏移][u32 块数][u32 flags][u64 magic]。
+ *               flags 没有 TABLE_INDEX_DELTA 时块索引是定长的旧格式，每块一项 [u64 块内最大 key][u32 偏移][u32 大小]。
+ *               flags 有 TABLE_CHECKSUM 时块索引中有每个块的 crc32c，footer 之前的 crc32c 覆盖 bloom、块索引和 footer；
+ *               没有时也没有这 4 字节。
+ *               flags 有 TABLE_HASHES 时 bloom 之前紧挨着 [u32 哈希]...[u32 crc32c]，按 key 顺序每个 key 一个
+ *               levelfilter::hash，用来建层过滤器（见 kvstore.h），平时不读进内存；没有 TABLE_CHECKSUM 时没有 crc32c。
+ *               flags 有 TABLE_COMPRESSED 时每个数据块后面有 1 字节的压缩类型，见 block.h。
+ *               内存中只保留块索引，点查只读一个块。
+ */
+enum TABLE_FORMAT {
+    TABLE_FLAT,
+    TABLE_BLOCK
+};
+
+const uint64_t TABLE_MAGIC = 0x6c736d6b76626c6bULL; // 用来区分两种格式
+const uint32_t FOOTER_SIZE = 56;
+const uint32_t BLOCK_ENTRY = 16; // 定长块索引一项的大小
+
+const uint32_t TABLE_HASHES      = 1; // footer flags：bloom 之前有每个 key 的哈希
+const uint32_t TABLE_INDEX_DELTA = 2; // footer flags：块索引用 blockindex 的变长编码
+const uint32_t TABLE_CHECKSUM    = 4; // footer flags：带校验和
+const uint32_t TABLE_COMPRESSED  = 8; // footer flags：数据块可能被压缩
+
 struct Index {
     uint64_t key;
     uint32_t offset;
@@ -32,7 +64,13 @@ protected:
     uint32_t curpos;         // 当前offset的位置
     uint32_t nameSuffix = 0; // 区分同一时间戳，不同文件的姓名后缀
     bloom filter;
-    std::vector<Index> index;
+    std::vector<Index> index;       // TABLE_FLAT 的索引
+    uint32_t format = TABLE_FLAT;
+    blockindex blocks;              // TABLE_BLOCK 的块索引
+    bool hashed     = false;        // 文件中有 TABLE_HASHES
+    bool compressed = false;        // 数据块带压缩类型，读出来要先 uncompressBlock
+
+    bool loadFooter(FILE *file);
 
 public:
     bool operator<(const sstablehead &other) const {
@@ -50,7 +88,7 @@ public:
         bytes  = 10240 + 32;
     }
 
-    void loadFileHead(const char *path);
+    bool loadFileHead(const char *path); // 文件损坏时返回 false
     void reset();
 
     void setFilename(std::string filename) {
@@ -81,18 +119,58 @@ public:
         this->bytes = bytes;
     }
 
-    void setFilter(bloom filter) {
-        this->filter.setBitset(filter.getBitset());
+    void setFilter(const bloom &filter) {
+        this->filter = filter;
     }
 
     void setIndex(std::vector<Index> index) {
         this->index = index;
     } // 使用深复制
 
-    std::string getFilename() {
+    void setBlocks(blockindex blocks) {
+        this->format = TABLE_BLOCK;
+        this->blocks = std::move(blocks);
+    }
+
+    std::string getFilename() const {
         return filename;
     }
 
+    uint32_t getFormat() const {
+        return format;
+    }
+
+    int blockCount() const {
+        return blocks.size();
+    }
+
+    void setHashed(bool hashed) {
+        this->hashed = hashed;
+    }
+
+    // 能不能取得每个 key 的哈希：TABLE_FLAT 由内存中的索引算出，TABLE_BLOCK 要文件中有 TABLE_HASHES
+    bool hasHashes() const {
+        return format == TABLE_FLAT || hashed;
+    }
+
+    bool loadHashes(std::vector<uint32_t> &hashes) const; // 按 key 顺序的 levelfilter::hash，读不出来时返回 false
+
+    bool hasChecksums() const {
+        return blocks.hasChecksums();
+    }
+
+    void setCompressed(bool compressed) {
+        this->compressed = compressed;
+    }
+
+    bool isCompressed() const {
+        return compressed;
+    }
+
+    BlockIndex getBlock(int p) const {
+        return blocks.get(p);
+    }
+
     uint64_t getTime() const {
         return time;
     }
@@ -109,7 +187,7 @@ public:
         return maxV;
     }
 
-    uint64_t getKey(int p) {
+    uint64_t getKey(int p) const {
         return index[p].key;
     }
 
@@ -121,7 +199,7 @@ public:
         return nameSuffix;
     }
 
-    uint32_t getOffset(int p) {
+    uint32_t getOffset(int p) const {
         return (p < 0) ? 0 : index[p].offset;
     }
 
@@ -129,10 +207,12 @@ public:
         return index[p];
     }
 
-    int searchOffset(uint64_t key, uint32_t &len);
+    int searchOffset(uint64_t key, uint32_t &len) const;
+    int findBlock(uint64_t key) const; // 可能含有 key 的块，bloom 或块索引排除时返回 -1
+    int seekBlock(uint64_t key) const; // 第一个最大 key >= key 的块，没有返回块数
 
-    int search(uint64_t key);
-    int lowerBound(uint64_t key); /*返回大于等于的第一个的下标 没有返回len + 1*/
+    int search(uint64_t key) const;
+    int lowerBound(uint64_t key) const; /*返回大于等于的第一个的下标 没有返回len + 1*/
     void showIndexs();
 };
 
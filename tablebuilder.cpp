@@ -0,0 +1,191 @@
+#include "tablebuilder.h"
+
+#include "crc32c.h"
+#include "levelfilter.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+tablebuilder::tablebuilder(
+    std::string path,
+    uint64_t time,
+    bool sync,
+    COMPRESSION_TYPE compression,
+    size_t bufferSize
+) :
+    path(std::move(path)),
+    time(time),
+    sync(sync),
+    compression(compression),
+    bufferSize(bufferSize) {
+    // 先写临时文件再改名，崩溃时不会留下写了一半的 sstable
+    tmpPath = this->path + ".tmp";
+    fd      = ::open(tmpPath.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Unable to open file " << tmpPath << ": " << strerror(errno) << std::endl;
+        failed = true;
+    }
+    buf.reserve(std::min<size_t>(bufferSize, 4 * 1024 * 1024) + 2 * BLOCK_SIZE);
+}
+
+tablebuilder::~tablebuilder() {
+    if (fd >= 0)
+        ::close(fd);
+    if (!finished)
+        utils::rmfile(tmpPath.data());
+}
+
+bool tablebuilder::add(uint64_t key, const char *val, uint32_t len) {
+    if (failed)
+        return false;
+    cnt++;
+    minV = std::min(minV, key);
+    maxV = std::max(maxV, key);
+    filter.insert(key);
+    hashes.push_back(levelfilter::hash(key));
+    block.add(key, val, len);
+    if (block.estimatedSize() >= BLOCK_SIZE) {
+        flushBlock();
+        if (buf.size() >= bufferSize)
+            return flushBuffer();
+    }
+    return true;
+}
+
+void tablebuilder::flushBlock() {
+    const std::string &data = block.finish();
+    size_t start            = buf.size();
+    if (compression == COMPRESSION_NONE)
+        buf.append(data);
+    else
+        compressBlock(data, compression, buf);
+    uint32_t size = buf.size() - start;
+    blocks.add({block.getLastKey(), (uint32_t)(offset + start), size, crc32c::value(buf.data() + start, size)});
+    block.reset();
+}
+
+bool tablebuilder::flushBuffer() {
+    const char *p = buf.data();
+    size_t left   = buf.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: Unable to write file " << tmpPath << ": " << strerror(errno) << std::endl;
+            failed = true;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    offset += buf.size();
+    buf.clear();
+    return true;
+}
+
+uint64_t tablebuilder::fileSize() const {
+    if (finished)
+        return offset;
+    uint64_t res = offset + buf.size() + hashes.size() * 4 + 4 + M + blocks.encodedSize() + 4 + FOOTER_SIZE;
+    if (!block.empty())
+        res += block.estimatedSize() + 2 * BLOCK_ENTRY; // 块索引中的一项不会超过 2 * BLOCK_ENTRY
+    return res;
+}
+
+bool tablebuilder::finish() {
+    if (failed)
+        return false;
+    if (!block.empty())
+        flushBlock();
+    // key 的哈希，自带校验和，不在下面的校验和覆盖的范围内，打开 sstable 时不用读
+    const char *h = reinterpret_cast<const char *>(hashes.data());
+    uint32_t hcrc = crc32c::value(h, hashes.size() * 4);
+    buf.append(h, hashes.size() * 4);
+    buf.append(reinterpret_cast<const char *>(&hcrc), 4);
+    uint32_t filterOffset = offset + buf.size();
+    buf.append(filter.data(), M); // bloom
+    uint32_t indexOffset = offset + buf.size();
+    blocks.encodeTo(buf); // 块索引
+    // footer
+    std::string footer;
+    uint32_t count = blocks.size(), flags = TABLE_INDEX_DELTA | TABLE_CHECKSUM | TABLE_HASHES;
+    if (compression != COMPRESSION_NONE)
+        flags |= TABLE_COMPRESSED;
+    footer.append(reinterpret_cast<const char *>(&time), 8);
+    footer.append(reinterpret_cast<const char *>(&cnt), 8);
+    footer.append(reinterpret_cast<const char *>(&minV), 8);
+    footer.append(reinterpret_cast<const char *>(&maxV), 8);
+    footer.append(reinterpret_cast<const char *>(&filterOffset), 4);
+    footer.append(reinterpret_cast<const char *>(&indexOffset), 4);
+    footer.append(reinterpret_cast<const char *>(&count), 4);
+    footer.append(reinterpret_cast<const char *>(&flags), 4);
+    footer.append(reinterpret_cast<const char *>(&TABLE_MAGIC), 8);
+    // bloom、块索引和 footer 的校验和
+    uint32_t crc = crc32c::value(buf.data() + (filterOffset - offset), buf.size() - (filterOffset - offset));
+    crc          = crc32c::extend(crc, footer.data(), footer.size());
+    buf.append(reinterpret_cast<const char *>(&crc), 4);
+    buf.append(footer);
+    if (!flushBuffer())
+        return false;
+
+    if (sync) {
+#ifdef __APPLE__
+        int res = ::fsync(fd);
+#else
+        int res = ::fdatasync(fd);
+#endif
+        if (res != 0) {
+            std::cerr << "Error: Unable to sync file " << tmpPath << ": " << strerror(errno) << std::endl;
+            failed = true;
+            return false;
+        }
+    }
+    int res = ::close(fd); // 部分文件系统到 close 时才报告写入错误
+    fd      = -1;
+    if (res != 0) {
+        std::cerr << "Error: Unable to close file " << tmpPath << ": " << strerror(errno) << std::endl;
+        failed = true;
+        return false;
+    }
+    if (std::rename(tmpPath.data(), path.data()) != 0) {
+        std::cerr << "Error: Unable to rename " << tmpPath << ": " << strerror(errno) << std::endl;
+        failed = true;
+        return false;
+    }
+    finished = true;
+    if (sync) { // 改名也要落盘，否则掉电后文件可能不在目录中
+        std::string dir = path.substr(0, path.find_last_of('/') + 1);
+        int dirFd       = ::open(dir.empty() ? "." : dir.data(), O_RDONLY | O_DIRECTORY);
+        if (dirFd < 0 || ::fsync(dirFd) != 0) {
+            std::cerr << "Error: Unable to sync directory " << dir << ": " << strerror(errno) << std::endl;
+            if (dirFd >= 0)
+                ::close(dirFd);
+            utils::rmfile(path.data());
+            return false;
+        }
+        ::close(dirFd);
+    }
+    return true;
+}
+
+sstablehead tablebuilder::getHead() const {
+    sstablehead res;
+    res.setFilename(path);
+    res.setTime(time);
+    res.setCnt(cnt);
+    res.setMinV(minV);
+    res.setMaxV(maxV);
+    res.setBytes(offset);
+    res.setFilter(filter);
+    res.setBlocks(blocks);
+    res.setHashed(true);
+    res.setCompressed(compression != COMPRESSION_NONE);
+    return res;
+}
@@ -0,0 +1,75 @@
+#ifndef LSM_KV_TABLEBUILDER_H
+#define LSM_KV_TABLEBUILDER_H
+
+#include "block.h"
+#include "bloom.h"
+#include "sstablehead.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * 流式写出 TABLE_BLOCK 格式的 sstable（格式见 sstablehead.h）。
+ * key 按升序逐条 add，写满一个块就放进写缓冲，缓冲满了再写进临时文件；
+ * 内存中只有当前块、写缓冲、bloom、块索引和每个 key 4 字节的哈希，与 value 的大小无关。
+ * finish 时补上 key 的哈希、bloom、块索引和 footer，需要时 fdatasync，最后改名成 path。
+ * 没有 finish 或 finish 失败时临时文件被删除，不会留下写了一半的 sstable。
+ * compression 不是 COMPRESSION_NONE 时每个块压缩后再放进写缓冲，见 block.h。
+ */
+class tablebuilder {
+public:
+    static const size_t WRITE_BUFFER = 64 * 1024;
+
+    // bufferSize 不小于整个文件时，finish 时一次写出
+    tablebuilder(
+        std::string path,
+        uint64_t time,
+        bool sync                    = false,
+        COMPRESSION_TYPE compression = COMPRESSION_NONE,
+        size_t bufferSize            = WRITE_BUFFER
+    );
+    ~tablebuilder();
+
+    tablebuilder(const tablebuilder &)            = delete;
+    tablebuilder &operator=(const tablebuilder &) = delete;
+
+    bool add(uint64_t key, const char *val, uint32_t len); // key 必须递增，写文件失败时返回 false
+    bool finish();
+
+    uint64_t getCnt() const {
+        return cnt;
+    }
+
+    uint64_t fileSize() const; // 文件的大小，finish 之前为现在 finish 的话的大小（压缩时偏大）
+
+    const blockindex &getBlocks() const {
+        return blocks;
+    }
+
+    sstablehead getHead() const; // finish 之后，与 loadFileHead 读到的相同
+
+private:
+    std::string path, tmpPath;
+    uint64_t time;
+    bool sync;
+    COMPRESSION_TYPE compression;
+    size_t bufferSize;
+    int fd        = -1;
+    bool failed   = false;
+    bool finished = false;
+
+    std::string buf;     // 还没有写进文件的数据
+    uint64_t offset = 0; // 已经写进文件的字节数
+    blockbuilder block;
+    bloom filter;
+    std::vector<uint32_t> hashes; // 每个 key 的 levelfilter::hash，见 sstablehead.h 的 TABLE_HASHES
+    blockindex blocks{true};
+    uint64_t cnt = 0, minV = UINT64_MAX, maxV = 0;
+
+    void flushBlock();  // 当前块放进写缓冲
+    bool flushBuffer(); // 写缓冲写进文件
+};
+
+#endif // LSM_KV_TABLEBUILDER_H
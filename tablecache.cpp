@@ -0,0 +1,64 @@
+#include "tablecache.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+tablehandle::~tablehandle() {
+    if (base)
+        ::munmap(const_cast<char *>(base), size);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+std::shared_ptr<tablehandle> tablecache::get(const std::string &filename) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = table.find(filename);
+    if (it != table.end()) {
+        lru.splice(lru.begin(), lru, it->second); // 移到最前
+        return it->second->second;
+    }
+
+    // 持锁打开，避免与 evict 交错时把已删除文件的句柄放进缓存；只有未命中时才会走到这里
+    auto handle = std::make_shared<tablehandle>();
+    handle->fd  = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (handle->fd < 0) {
+        std::cerr << "Error: Unable to open file " << filename << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    if (useMmap && ::fstat(handle->fd, &st) == 0 && st.st_size > 0) {
+        // sstable 写完之后不再修改，映射一次可以一直用到文件被删除；映射失败时退回 pread
+        void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, handle->fd, 0);
+        if (p != MAP_FAILED) {
+            handle->base = static_cast<const char *>(p);
+            handle->size = st.st_size;
+        }
+    }
+    lru.emplace_front(filename, handle);
+    table[filename] = lru.begin();
+    while (lru.size() > capacity) {
+        table.erase(lru.back().first);
+        lru.pop_back();
+    }
+    return handle;
+}
+
+void tablecache::evict(const std::string &filename) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = table.find(filename);
+    if (it == table.end())
+        return;
+    lru.erase(it->second);
+    table.erase(it);
+}
+
+void tablecache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    lru.clear();
+    table.clear();
+}
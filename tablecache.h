@@ -0,0 +1,53 @@
+#ifndef LSM_KV_TABLECACHE_H
+#define LSM_KV_TABLECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 一个打开的 sstable 文件，最后一个引用释放时关闭（并解除映射）
+class tablehandle {
+public:
+    int fd           = -1;
+    const char *base = nullptr; // mmap 模式下整个文件的映射，否则为 nullptr
+    size_t size      = 0;
+
+    tablehandle() {}
+
+    tablehandle(const tablehandle &) = delete;
+    tablehandle &operator=(const tablehandle &) = delete;
+
+    ~tablehandle();
+};
+
+/*
+ * 按文件名缓存打开的 sstable，最多保留 capacity 个，超出时关闭最久未使用的。
+ * 返回 shared_ptr，被淘汰或 evict 的文件要等正在使用它的读者用完才真正关闭。
+ * 线程安全。
+ */
+class tablecache {
+private:
+    using entry = std::pair<std::string, std::shared_ptr<tablehandle>>;
+
+    size_t capacity;
+    bool useMmap; // 打开时把整个文件映射进来，读取不再需要系统调用
+    std::mutex lock;
+    std::list<entry> lru; // 越靠前越新
+    std::unordered_map<std::string, std::list<entry>::iterator> table;
+
+public:
+    tablecache(size_t capacity, bool useMmap) : capacity(capacity), useMmap(useMmap) {}
+
+    tablecache(const tablecache &) = delete;
+    tablecache &operator=(const tablecache &) = delete;
+
+    // 打开失败时返回 nullptr
+    std::shared_ptr<tablehandle> get(const std::string &filename);
+    void evict(const std::string &filename); // 删除文件之前调用
+    void clear();
+};
+
+#endif // LSM_KV_TABLECACHE_H
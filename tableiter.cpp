@@ -0,0 +1,87 @@
+#include "tableiter.h"
+
+#include "kvstore.h"
+
+void tableiter::loadBlock() {
+    for (; pos < head->blockCount(); ++pos) {
+        block = store->openBlock(*head, pos);
+        block.seekToFirst();
+        if (block.valid())
+            return;
+        if (block.corrupted()) {
+            corrupt = true;
+            return;
+        }
+    }
+}
+
+void tableiter::nextBlock() {
+    if (block.corrupted()) {
+        corrupt = true;
+        return;
+    }
+    pos++;
+    loadBlock();
+}
+
+void tableiter::seekToFirst() {
+    pos     = 0;
+    corrupt = false;
+    if (head->getFormat() == TABLE_BLOCK)
+        loadBlock();
+}
+
+void tableiter::seek(uint64_t key) {
+    corrupt = false;
+    if (head->getFormat() != TABLE_BLOCK) {
+        pos = head->lowerBound(key);
+        return;
+    }
+    pos = head->seekBlock(key);
+    if (pos >= head->blockCount())
+        return;
+    block = store->openBlock(*head, pos);
+    block.seek(key);
+    if (!block.valid())
+        nextBlock();
+}
+
+bool tableiter::valid() const {
+    if (head->getFormat() != TABLE_BLOCK)
+        return pos < (int)head->getCnt();
+    return pos < head->blockCount() && block.valid();
+}
+
+void tableiter::next() {
+    if (head->getFormat() != TABLE_BLOCK) {
+        pos++;
+        return;
+    }
+    block.next();
+    if (!block.valid())
+        nextBlock();
+}
+
+uint64_t tableiter::key() const {
+    if (head->getFormat() != TABLE_BLOCK)
+        return head->getKey(pos);
+    return block.key();
+}
+
+std::string tableiter::value() const {
+    if (head->getFormat() != TABLE_BLOCK) {
+        uint32_t start = head->getOffset(pos - 1);
+        uint32_t len   = head->getOffset(pos) - start;
+        return store->fetchString(head->getFilename(), 10240 + 32 + head->getCnt() * 12 + start, len);
+    }
+    return block.value();
+}
+
+valueref tableiter::valueRef() const {
+    if (head->getFormat() != TABLE_BLOCK) {
+        uint32_t start = head->getOffset(pos - 1);
+        uint32_t len   = head->getOffset(pos) - start;
+        return store->fetchRef(head->getFilename(), 10240 + 32 + head->getCnt() * 12 + start, len);
+    }
+    return block.valueRef();
+}
@@ -0,0 +1,51 @@
+#ifndef LSM_KV_TABLEITER_H
+#define LSM_KV_TABLEITER_H
+
+#include "block.h"
+#include "sstablehead.h"
+#include "valueref.h"
+
+#include <cstdint>
+#include <string>
+
+class KVStore;
+
+/*
+ * 按 key 顺序遍历一个 sstable，两种格式都支持：
+ * TABLE_BLOCK 每次读入一个块；TABLE_FLAT 用内存中的索引，每个 value 单独读。
+ * 读取经过 KVStore（table cache），head 在迭代期间不能被修改或释放。
+ * 遇到读不出来、校验或解压失败、格式不对的块时停下，之后 valid() 为假、corrupted() 为真，不会跳过这个块往后走。
+ */
+class tableiter {
+private:
+    KVStore *store          = nullptr;
+    const sstablehead *head = nullptr;
+    int pos                 = 0; // TABLE_BLOCK 为当前块号，TABLE_FLAT 为当前 key 的下标
+    blockiter block;             // TABLE_BLOCK 的当前块
+    bool corrupt = false;
+
+    void loadBlock(); // 读入 pos 号块并定位到第一个条目，空块则继续往后
+    void nextBlock(); // 当前块走完之后换到下一块，当前块有损坏时停下
+
+public:
+    tableiter(KVStore *store, const sstablehead *head) : store(store), head(head) {}
+
+    void seekToFirst();
+    void seek(uint64_t key); // 定位到第一个 >= key 的位置
+    bool valid() const;
+
+    bool corrupted() const {
+        return corrupt;
+    }
+
+    const sstablehead &table() const {
+        return *head;
+    }
+
+    void next();
+    uint64_t key() const;
+    std::string value() const;
+    valueref valueRef() const; // 不拷贝 value，见 valueref
+};
+
+#endif // LSM_KV_TABLEITER_H
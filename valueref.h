@@ -0,0 +1,62 @@
+#ifndef LSM_KV_VALUEREF_H
+#define LSM_KV_VALUEREF_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * 一个 value 的只读引用，读取时不拷贝 value。
+ * 同时持有 value 所在内存的所有者：block cache 中的块、mmap 映射的文件，或者一份自己的拷贝（memtable 中的 value）。
+ * 引用存在期间这块内存不会释放，即使块被挤出缓存、sstable 被 compaction 删除；不再需要时尽早释放，避免长期占住内存。
+ */
+class valueref {
+private:
+    std::shared_ptr<const void> owner;
+    const char *ptr = nullptr;
+    size_t len      = 0;
+
+public:
+    valueref() {}
+
+    valueref(std::shared_ptr<const void> owner, const char *ptr, size_t len) :
+        owner(std::move(owner)),
+        ptr(ptr),
+        len(len) {}
+
+    explicit valueref(std::string value) { // 保存一份自己的拷贝
+        auto copy = std::make_shared<const std::string>(std::move(value));
+        ptr       = copy->data();
+        len       = copy->size();
+        owner     = std::move(copy);
+    }
+
+    const char *data() const {
+        return ptr;
+    }
+
+    size_t size() const {
+        return len;
+    }
+
+    bool empty() const {
+        return len == 0;
+    }
+
+    std::string_view view() const {
+        return std::string_view(ptr, len);
+    }
+
+    std::string toString() const {
+        return std::string(ptr, len);
+    }
+
+    void reset() {
+        owner.reset();
+        ptr = nullptr;
+        len = 0;
+    }
+};
+
+#endif // LSM_KV_VALUEREF_H
@@ -0,0 +1,109 @@
+#include "vector_memtable.h"
+
+#include <algorithm>
+#include <cstring>
+
+int64_t vector_memtable::upsert(uint64_t key, const std::string &str) {
+    char *val = mem.allocate(str.size());
+    std::memcpy(val, str.data(), str.size());
+    entries.push_back({key, val, (uint32_t)str.size()});
+    bytes += 12 + str.size();
+    return 12 + str.size();
+}
+
+/*
+ * 新追加的部分稳定排序后与前面已排序的部分稳定归并，相同的 key 按写入顺序相邻，保留最后一个。
+ * 追加得少时代价接近线性，不必每次都对整个数组排序。
+ */
+void vector_memtable::sortEntries() {
+    if (sorted == entries.size())
+        return;
+    auto byKey = [](const entry &a, const entry &b) { return a.key < b.key; };
+    std::stable_sort(entries.begin() + sorted, entries.end(), byKey);
+    std::inplace_merge(entries.begin(), entries.begin() + sorted, entries.end(), byKey);
+
+    size_t out = 0;
+    bytes      = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (out && entries[out - 1].key == entries[i].key) {
+            bytes -= entries[out - 1].len;
+            entries[out - 1] = entries[i];
+        } else {
+            bytes += 12;
+            entries[out++] = entries[i];
+        }
+        bytes += entries[i].len;
+    }
+    entries.resize(out);
+    sorted = out;
+}
+
+bool vector_memtable::find(uint64_t key, const char *&val, uint32_t &len) {
+    sortEntries();
+    auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const entry &e, uint64_t k) {
+        return e.key < k;
+    });
+    if (it == entries.end() || it->key != key)
+        return false;
+    val = it->val;
+    len = it->len;
+    return true;
+}
+
+void vector_memtable::scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) {
+    sortEntries();
+    auto it = std::lower_bound(entries.begin(), entries.end(), key1, [](const entry &e, uint64_t k) {
+        return e.key < k;
+    });
+    for (; it != entries.end() && it->key <= key2; ++it)
+        list.emplace_back(it->key, std::string(it->val, it->len));
+}
+
+class vector_memtable::iter : public memiter {
+private:
+    const entry *cur;
+    const entry *end;
+
+public:
+    iter(const entry *begin, const entry *end) : cur(begin), end(end) {}
+
+    bool valid() override {
+        return cur != end;
+    }
+
+    void next() override {
+        cur++;
+    }
+
+    uint64_t key() override {
+        return cur->key;
+    }
+
+    const char *val() override {
+        return cur->val;
+    }
+
+    uint32_t len() override {
+        return cur->len;
+    }
+};
+
+std::unique_ptr<memiter> vector_memtable::begin() {
+    sortEntries();
+    return std::make_unique<iter>(entries.data(), entries.data() + entries.size());
+}
+
+void vector_memtable::reset() {
+    mem.reset();
+    entries.clear();
+    sorted = 0;
+    bytes  = 0;
+}
+
+uint32_t vector_memtable::getBytes() {
+    return bytes;
+}
+
+size_t vector_memtable::memoryUsage() {
+    return mem.memoryUsage() + entries.capacity() * sizeof(entry);
+}
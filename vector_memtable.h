@@ -0,0 +1,40 @@
+#ifndef LSM_KV_VECTOR_MEMTABLE_H
+#define LSM_KV_VECTOR_MEMTABLE_H
+
+#include "arena.h"
+#include "memtable.h"
+
+/*
+ * 只追加的数组 memtable：写入只是在末尾追加一项，不做任何查找；
+ * 第一次读、scan 或落盘时才把新追加的部分排序并与已排好的部分归并，同一个 key 只保留最后一次写入。
+ * 适合几乎只写不读的批量导入。getBytes 在排序去重之前把重复的 key 也计算在内，是一个上界。
+ */
+class vector_memtable : public memtable {
+private:
+    struct entry {
+        uint64_t key;
+        const char *val;
+        uint32_t len;
+    };
+
+    arena mem; // value 的内存
+    std::vector<entry> entries;
+    size_t sorted  = 0; // entries 的前 sorted 项已排序且 key 互不相同
+    uint32_t bytes = 0;
+
+    class iter;
+    void sortEntries();
+
+public:
+    vector_memtable() {}
+
+    int64_t upsert(uint64_t key, const std::string &str) override;
+    bool find(uint64_t key, const char *&val, uint32_t &len) override;
+    void scan(uint64_t key1, uint64_t key2, std::vector<std::pair<uint64_t, std::string>> &list) override;
+    std::unique_ptr<memiter> begin() override;
+    void reset() override;
+    uint32_t getBytes() override;
+    size_t memoryUsage() override;
+};
+
+#endif // LSM_KV_VECTOR_MEMTABLE_H
@@ -0,0 +1,124 @@
+#include "wal.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+bool wal::open(const std::string &path) {
+    close();
+    this->path = path;
+    fd         = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Unable to open log " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool wal::append(const std::string &record, bool sync) {
+    const char *p = record.data();
+    size_t left   = record.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: Unable to write log " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    if (sync) {
+#ifdef __APPLE__
+        int res = ::fsync(fd);
+#else
+        int res = ::fdatasync(fd);
+#endif
+        if (res != 0) {
+            std::cerr << "Error: Unable to sync log " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void wal::close() {
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+void wal::appendEntry(std::string &entries, uint8_t type, uint64_t key, const std::string &val) {
+    uint32_t len = val.size();
+    entries.append(reinterpret_cast<const char *>(&type), 1);
+    entries.append(reinterpret_cast<const char *>(&key), 8);
+    entries.append(reinterpret_cast<const char *>(&len), 4);
+    entries.append(val);
+}
+
+std::string wal::makeRecord(const std::string &entries, uint32_t count) {
+    uint32_t payload = 4 + entries.size();
+    std::string record;
+    record.reserve(4 + payload);
+    record.append(reinterpret_cast<const char *>(&payload), 4);
+    record.append(reinterpret_cast<const char *>(&count), 4);
+    record.append(entries);
+    return record;
+}
+
+int wal::decodeEntries(const char *p, size_t len, const std::function<void(uint8_t, uint64_t, std::string &&)> &f) {
+    size_t pos = 0;
+    int count  = 0;
+    while (pos < len) {
+        if (pos + 13 > len)
+            return -1;
+        uint8_t type = p[pos];
+        uint64_t key;
+        uint32_t vlen;
+        std::memcpy(&key, p + pos + 1, 8);
+        std::memcpy(&vlen, p + pos + 9, 4);
+        pos += 13;
+        if (pos + vlen > len)
+            return -1;
+        f(type, key, std::string(p + pos, vlen));
+        pos += vlen;
+        count++;
+    }
+    return count;
+}
+
+int wal::replay(const std::string &path, const std::function<void(uint8_t, uint64_t, std::string &&)> &f) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    std::string content;
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+        content.append(buf, n);
+    ::close(fd);
+
+    int records = 0;
+    size_t pos  = 0;
+    while (pos + 4 <= content.size()) {
+        uint32_t payload, count;
+        std::memcpy(&payload, content.data() + pos, 4);
+        if (payload < 4 || pos + 4 + payload > content.size())
+            break; // 崩溃时没有写完的记录
+        std::memcpy(&count, content.data() + pos + 4, 4);
+        const char *entries = content.data() + pos + 8;
+        // 先完整校验再回调，保证一条记录要么全部生效要么全部丢弃
+        if (decodeEntries(entries, payload - 4, [](uint8_t, uint64_t, std::string &&) {}) != (int)count)
+            break;
+        decodeEntries(entries, payload - 4, f);
+        pos += 4 + payload;
+        records++;
+    }
+    if (pos != content.size())
+        std::cerr << "Warning: dropped " << content.size() - pos << " trailing bytes of log " << path << std::endl;
+    return records;
+}
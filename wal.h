@@ -0,0 +1,57 @@
+#ifndef LSM_KV_WAL_H
+#define LSM_KV_WAL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+ * 写前日志 (write-ahead log)。
+ * 每个 memtable 对应一个日志文件 <dir>/<number>.log，memtable 写入 level-0 之后删除。
+ *
+ * 记录格式：
+ *   [u32 payload 长度][u32 条目数][条目]...
+ *   条目 = [u8 type][u64 key][u32 value 长度][value]
+ * 一条记录是一次提交（可能包含多个写请求），重放时末尾不完整的记录会被丢弃。
+ */
+
+enum WAL_TYPE : uint8_t {
+    WAL_DEL = 0,
+    WAL_PUT = 1
+};
+
+class wal {
+private:
+    int fd = -1;
+    std::string path;
+
+public:
+    wal() {}
+
+    wal(const wal &) = delete;
+    wal &operator=(const wal &) = delete;
+
+    ~wal() {
+        close();
+    }
+
+    bool open(const std::string &path);                 // 以追加方式打开，不存在则创建
+    bool append(const std::string &record, bool sync);  // 写入一条完整的记录
+    void close();
+
+    std::string getPath() const {
+        return path;
+    }
+
+    // 向 entries 末尾追加一个条目
+    static void appendEntry(std::string &entries, uint8_t type, uint64_t key, const std::string &val);
+    // 由条目拼成一条记录
+    static std::string makeRecord(const std::string &entries, uint32_t count);
+    // 依次回调 entries 中的每个条目，返回条目数，格式错误时返回 -1
+    static int
+    decodeEntries(const char *p, size_t len, const std::function<void(uint8_t, uint64_t, std::string &&)> &f);
+    // 重放一个日志文件，返回成功重放的记录数
+    static int replay(const std::string &path, const std::function<void(uint8_t, uint64_t, std::string &&)> &f);
+};
+
+#endif // LSM_KV_WAL_H
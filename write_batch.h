@@ -0,0 +1,41 @@
+#pragma once
+
+#include "wal.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+ * 一组 put/del，通过 KVStore::write 一次提交：
+ * 整组作为一条写前日志记录写入，只做一次是否切换 memtable 的判断，崩溃后要么全部恢复要么全部丢弃。
+ * 同一个 key 在组内多次出现时，后面的操作生效。
+ * 读者一般看到的是整组写入之前或之后的状态；但 Options::memtable 为 MEMTABLE_CONCURRENT 时，
+ * 各条目在 memLock 之外逐条插入 memtable，write 返回之前并发的读者可能只看到其中一部分。
+ */
+class WriteBatch {
+private:
+    friend class KVStore;
+    std::string rep; // 与写前日志中的条目格式相同，提交时直接使用
+    uint32_t cnt = 0;
+
+public:
+    void put(uint64_t key, const std::string &val) {
+        wal::appendEntry(rep, WAL_PUT, key, val);
+        cnt++;
+    }
+
+    // 与 Options::blindDelete 相同，不检查 key 是否存在
+    void del(uint64_t key) {
+        wal::appendEntry(rep, WAL_DEL, key, "");
+        cnt++;
+    }
+
+    uint32_t count() const {
+        return cnt;
+    }
+
+    void clear() {
+        rep.clear();
+        cnt = 0;
+    }
+};